@@ -56,6 +56,7 @@ static struct {
     struct arg_str *command;
     struct arg_str *url;
     struct arg_str *ip_address;
+    struct arg_lit *reset;
     struct arg_end *end;
 } socket_args;
 
@@ -119,6 +120,29 @@ static int update_socket(int argc, char **argv)
         drv_socket_list();
     }    
     else
+    if ((strcmp(socket_command,"stats") == 0) || (strcmp(socket_command,"tcp") == 0))
+    {
+        /* name optional - all sockets if not given */
+        drv_socket_t* pSocket = NULL;
+        if (strlen(socket_name) > 0)
+        {
+            pSocket = drv_socket_get_handle(socket_name);
+            if (pSocket == NULL)
+            {
+                ESP_LOGE(TAG, "Error Socket %s not found", socket_name);
+                return 0;
+            }
+        }
+        if (strcmp(socket_command,"tcp") == 0)
+        {
+            drv_socket_tcp_info(pSocket);
+        }
+        else
+        {
+            drv_socket_stats(pSocket, socket_args.reset->count > 0);
+        }
+    }
+    else
     if (strlen(socket_name) > 0)
     {
         int index = drv_socket_get_position(socket_name);
@@ -166,8 +190,9 @@ static void register_socket(void)
     socket_args.ip_address = arg_strn("a", "ip", "<ip address>", 0, 1, "Command can be : socket -n socket_name -a 192.168.0.5");
     socket_args.url = arg_strn("u", "url", "<URL>", 0, 1, "Command can be : socket -n socket_name -u url_name");
     socket_args.name = arg_strn("n", "name", "<name>", 0, 1, "Command can be : socket [-n socket_name]");
-    socket_args.command = arg_strn(NULL, NULL, "<command>", 0, 1, "Command can be : socket {reset|start|stop|list}");
-    socket_args.end = arg_end(5);
+    socket_args.command = arg_strn(NULL, NULL, "<command>", 0, 1, "Command can be : socket {reset|start|stop|list|stats|tcp}");
+    socket_args.reset = arg_lit0(NULL, "reset", "Command can be : socket stats [-n socket_name] --reset");
+    socket_args.end = arg_end(6);
 
     const esp_console_cmd_t cmd_socket = {
         .command = "socket",
@@ -24,13 +24,19 @@
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "freertos/stream_buffer.h"
+#include "freertos/queue.h"
 #include "esp_system.h"
+#include "esp_random.h"
 #include "esp_log.h"
 #include "esp_event.h"
+#include "esp_timer.h"
 #include "lwip/err.h"
 #include "lwip/sockets.h"
 #include "lwip/sys.h"
 #include "lwip/priv/tcp_priv.h"
+#include "lwip/priv/sockets_priv.h"
+#include "lwip/tcpip.h"
+#include "lwip/priv/tcpip_priv.h"
 #include "lwip/inet.h"
 #include "lwip/netdb.h"
 //#include "lwip/dns.h"
@@ -44,7 +50,14 @@
 #include "esp_mac.h"
 
 //#include "drv_system_if.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include <stdio.h>
+#else
+#include "nvs.h"
+#endif
+
 #if CONFIG_DRV_ETH_USE
+#include "esp_eth.h"
 #include "drv_eth.h"
 #endif
 
@@ -69,8 +82,43 @@
 #define DRV_SOCKET_TASK_REST_TIME_MS    10
 #define DRV_SOCKET_PING_SEND_TIME_MS    10000
 #define DRV_SOCKET_RECONNECT_TIME_MS    5000
-
-#define DRV_SOCKET_COUNT_MAX            10
+#define DRV_SOCKET_RECONNECT_TIME_MAX_MS    CONFIG_DRV_SOCKET_RECONNECT_TIME_MAX_MS
+#define DRV_SOCKET_IDENTIFY_TIME_MS     10000
+#define DRV_SOCKET_EVENT_WAIT_TIME_MS   CONFIG_DRV_SOCKET_EVENT_WAIT_TIME_MS
+#define DRV_SOCKET_CONNECT_TIMEOUT_MS   CONFIG_DRV_SOCKET_CONNECT_TIMEOUT_MS
+#define DRV_SOCKET_INTERFACE_REFRESH_TIME_MS    CONFIG_DRV_SOCKET_INTERFACE_REFRESH_TIME_MS
+#define DRV_SOCKET_INTERFACE_SETTLE_TIME_MS     100     /* second refresh after an event (drv_eth/drv_wifi handler order) */
+#define DRV_SOCKET_DNS_CACHE_SIZE       CONFIG_DRV_SOCKET_DNS_CACHE_SIZE
+#define DRV_SOCKET_DNS_CACHE_TTL_MS     (CONFIG_DRV_SOCKET_DNS_CACHE_TTL_S * 1000)
+#define DRV_SOCKET_DNS_RETRY_TIME_MS    10000   /* failed resolve not repeated before */
+#define DRV_SOCKET_DNS_WAIT_TIME_MS     CONFIG_DRV_SOCKET_DNS_WAIT_TIME_MS
+#define DRV_SOCKET_DNS_TASK_STACK_SIZE  3072
+#define DRV_SOCKET_CONNECT_RACE_STAGGER_MS  CONFIG_DRV_SOCKET_CONNECT_RACE_STAGGER_MS
+#define DRV_SOCKET_PERSIST_NAMESPACE    "drv_socket"
+#define DRV_SOCKET_PERSIST_KEY_FORMAT   "last_%s"       /* NVS key max 15 chars - cName max 7 */
+#define DRV_SOCKET_PERSIST_FILE_FORMAT  "drv_socket_%s.bin"     /* host builds (linux target) */
+#define DRV_SOCKET_PERSIST_VERSION      1
+
+#define DRV_SOCKET_COUNT_MAX            CONFIG_DRV_SOCKET_COUNT_MAX
+#define DRV_SOCKET_REACTOR_COUNT        CONFIG_DRV_SOCKET_REACTOR_COUNT
+#define DRV_SOCKET_REACTOR_STACK_SIZE   CONFIG_DRV_SOCKET_REACTOR_STACK_SIZE
+#define DRV_SOCKET_TASK_STACK_SIZE      CONFIG_DRV_SOCKET_TASK_STACK_SIZE
+
+#define MAX_TCP_READ_SIZE               CONFIG_DRV_SOCKET_MAX_TCP_READ_SIZE
+#define MAX_TCP_SEND_CHUNK_SIZE         CONFIG_DRV_SOCKET_MAX_TCP_SEND_SIZE
+#define DRV_SOCKET_SEND_BULK_CHUNK_SIZE CONFIG_DRV_SOCKET_SEND_BULK_CHUNK_SIZE
+#define DRV_SOCKET_COALESCE_TIME_MS     2
+#define DRV_SOCKET_WATERMARK_POLL_TIME_MS   10      /* stream fill checked while a watermark is exceeded (or on drv_socket_wakeup()) */
+#define DRV_SOCKET_LATENCY_POLL_TIME_MS     5       /* resolution of the application pull times (and of the enqueue times without drv_socket_wakeup) */
+#define DRV_SOCKET_ACK_POLL_TIME_MS         10      /* tcp_pcb ack state checked while send markers are pending */
+#define DRV_SOCKET_FAILOVER_POLL_TIME_MS    10      /* old connection tcp_pcb checked while the failover drains it */
+#define DRV_SOCKET_FAILOVER_DRAIN_TIME_MS   3000    /* old connection unsent and unacked bytes waited for before the switch */
+#define DRV_SOCKET_MULTIPATH_STEER_TIME_MS  500     /* tcp rtt of the multipath connections compared */
+#define DRV_SOCKET_FRAME_QUEUE_HEADER_SIZE  3       /* payload length (u16), flags - before each frame in pSendStreamBuffer[0] */
+//#define MAX_TCP_SEND_SIZE CONFIG_LWIP_TCP_SND_BUF_DEFAULT
+#define MAX_TCP_SEND_SIZE               16384   /* max bytes passed to the stack per connection per loop (weight 1) */
+#define DRV_SOCKET_SEND_QUANTUM         CONFIG_DRV_SOCKET_SEND_QUANTUM
+#define DRV_SOCKET_SEND_ROUNDS          ((MAX_TCP_SEND_SIZE + DRV_SOCKET_SEND_QUANTUM - 1) / DRV_SOCKET_SEND_QUANTUM)
 
 /* *****************************************************************************
  * Constants and Macros Definitions
@@ -83,6 +131,42 @@
 /* *****************************************************************************
  * Type Definitions
  **************************************************************************** */
+typedef struct
+{
+    TaskHandle_t pTask;
+    drv_socket_wakeup_t wakeup;
+    drv_socket_t* apSocket[DRV_SOCKET_COUNT_MAX];
+    int nSocketCount;
+    portMUX_TYPE lock;                      // protects apSocket/nSocketCount (attach from other tasks)
+    bool bStarting;                         // task being created by an attaching socket (socket_reactor_start_lock)
+
+} drv_socket_reactor_t;
+
+typedef struct
+{
+    drv_socket_connection_id_t nConnectionId;
+    uint32_t u32Marker;
+    int8_t nLane;
+} drv_socket_ack_request_t;
+
+typedef struct
+{
+    struct tcpip_api_call_data call;        // first - tcpip_api_call() argument
+    int nSocket;
+    drv_socket_tcp_info_t* pInfo;
+    bool bResult;
+} drv_socket_tcp_info_call_t;
+
+typedef struct
+{
+    char cURL[32];
+    char cIP[16];
+    bool bValid;                            // cIP resolved at least once
+    bool bResolving;                        // queued to or being resolved by the resolver task
+    TickType_t nExpireTick;                 // refresh after this tick (stale cIP still served)
+    TickType_t nUseTick;                    // last use (least recently used entry replaced)
+
+} drv_socket_dns_entry_t;
 
 /* *****************************************************************************
  * Function-Like Macros
@@ -95,16 +179,58 @@ drv_socket_t * pSocketList[DRV_SOCKET_COUNT_MAX] = {NULL};
 int nSocketListCount = 0;
 int nSocketCountTotal = 0;
 
-TickType_t nReconnectTimeTicks = pdMS_TO_TICKS(DRV_SOCKET_RECONNECT_TIME_MS);
 TickType_t nTaskRestTimeTicks = pdMS_TO_TICKS(DRV_SOCKET_TASK_REST_TIME_MS);
 
 uint8_t last_mac_addr_on_identification_request[6] = {0};
 
+volatile uint32_t u32InterfaceEventCount = 0;   /* incremented on each IP/WIFI/ETH event */
+volatile bool bInterfaceEventsRegistered = false;
+bool bInterfaceEventsRegistering = false;       /* registration claimed by a socket task (socket_events_lock) */
+esp_event_handler_instance_t interface_event_instance_ip = NULL;
+#if CONFIG_DRV_WIFI_USE
+esp_event_handler_instance_t interface_event_instance_wifi = NULL;
+#endif
+#if CONFIG_DRV_ETH_USE
+esp_event_handler_instance_t interface_event_instance_eth = NULL;
+#endif
+
+portMUX_TYPE socket_runtime_lock = portMUX_INITIALIZER_UNLOCKED;    // protects pRuntime attach/release, runtime users and wakeup pending flags
+portMUX_TYPE socket_list_lock = portMUX_INITIALIZER_UNLOCKED;       // protects pSocketList/nSocketListCount (event and resolver tasks)
+portMUX_TYPE socket_events_lock = portMUX_INITIALIZER_UNLOCKED;     // protects the interface events registration state (socket tasks)
+
+drv_socket_reactor_t socket_reactor[DRV_SOCKET_REACTOR_COUNT] = 
+{
+    [0 ... (DRV_SOCKET_REACTOR_COUNT - 1)] = {.pTask = NULL, .nSocketCount = 0, .lock = portMUX_INITIALIZER_UNLOCKED, .bStarting = false},
+};
+portMUX_TYPE socket_reactor_start_lock = portMUX_INITIALIZER_UNLOCKED;  // protects reactor start claims and the reactor selection
+
+#if CONFIG_DRV_DNS_USE
+drv_socket_dns_entry_t socket_dns_cache[DRV_SOCKET_DNS_CACHE_SIZE] = {0};
+portMUX_TYPE socket_dns_lock = portMUX_INITIALIZER_UNLOCKED;       // protects socket_dns_cache (socket tasks and resolver task)
+QueueHandle_t socket_dns_queue = NULL;                              // indexes of socket_dns_cache to resolve
+TaskHandle_t socket_dns_task = NULL;
+bool bSocketDnsActive = true;
+#endif
+
 /* *****************************************************************************
  * Prototype of functions definitions
  **************************************************************************** */
 void socket_set_options(drv_socket_t* pSocket, int nConnectionIndex);
 void socket_on_connect(drv_socket_t* pSocket, int nConnectionIndex);
+void socket_connection_handshake_init(drv_socket_t* pSocket, int nConnectionIndex);
+void socket_prepare_ip_info(drv_socket_t* pSocket);
+void socket_race_stop(drv_socket_t* pSocket);
+void socket_multipath_stop(drv_socket_t* pSocket);
+void socket_multipath_remove(drv_socket_t* pSocket, int nConnectionIndex);
+bool socket_event_writable(drv_socket_t* pSocket, int nConnectionIndex);
+void socket_latency_reset(drv_socket_t* pSocket, int nConnectionIndex);
+void socket_latency_enqueued(drv_socket_t* pSocket, drv_socket_runtime_t* pRuntime);
+void socket_latency_print(drv_socket_t* pSocket, int nConnectionIndex);
+void socket_ack_sent(drv_socket_t* pSocket, int nConnectionIndex);
+void socket_ack_fail(drv_socket_t* pSocket, int nConnectionIndex);
+void socket_reactor_detach(drv_socket_reactor_t* pReactor, drv_socket_t* pSocket);
+int socket_list_pin(drv_socket_t* pSocket, drv_socket_t** apSocket, drv_socket_runtime_t** apRuntime);
+void socket_runtime_put(drv_socket_runtime_t* pRuntime);
 
 /* *****************************************************************************
  * Functions
@@ -126,9 +252,81 @@ void drv_socket_list(void)
     }
 }
 
+void socket_stats_reset(drv_socket_t* pSocket)
+{
+    int64_t nTimeUs = esp_timer_get_time();
+    memset(&pSocket->stats, 0, sizeof(pSocket->stats));
+    pSocket->stats.nStartTimeUs = nTimeUs;
+    for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
+    {
+        memset(&pSocket->connectionStats[nIndex], 0, sizeof(pSocket->connectionStats[nIndex]));
+        pSocket->connectionStats[nIndex].nStartTimeUs = nTimeUs;
+        socket_latency_reset(pSocket, nIndex);
+    }
+}
+
+/* bytes per second since nStartTimeUs */
+uint32_t socket_stats_rate(uint64_t u64Bytes, int64_t nStartTimeUs, int64_t nTimeUs)
+{
+    int64_t nElapsedUs = nTimeUs - nStartTimeUs;
+    if (nElapsedUs <= 0) return 0;
+    return (uint32_t)((u64Bytes * 1000000ULL) / (uint64_t)nElapsedUs);
+}
+
+void socket_stats_print(drv_socket_t* pSocket)
+{
+    drv_socket_stats_t* pStats = &pSocket->stats;
+    int64_t nTimeUs = esp_timer_get_time();
+    uint32_t u32Loops = pStats->u32Loops;
+
+    ESP_LOGI(TAG, "Socket %s stats for %d s: Loops:%u(avg %u us|max %u us) Connects:%u Fails:%u Reconnects:%u Rejects:%u AllocFails:%u",
+        pSocket->cName, (int)((nTimeUs - pStats->nStartTimeUs) / 1000000),
+        (unsigned)u32Loops, (unsigned)((u32Loops > 0) ? (pStats->u64LoopTimeUs / u32Loops) : 0), (unsigned)pStats->u32LoopTimeMaxUs,
+        (unsigned)pStats->u32Connects, (unsigned)pStats->u32ConnectFails, (unsigned)pStats->u32Reconnects,
+        (unsigned)pStats->u32AcceptRejects, (unsigned)pStats->u32AllocFails);
+    if (pSocket->multipath != DRV_SOCKET_MULTIPATH_OFF)
+    {
+        ESP_LOGI(TAG, "  %s frames Dups:%u DupSkips:%u Lost:%u", pSocket->cName,
+            (unsigned)pStats->u32FrameDups, (unsigned)pStats->u32FrameDupSkips, (unsigned)pStats->u32FrameLost);
+    }
+
+    for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
+    {
+        if (pSocket->nSocketIndexPrimer[nIndex] < 0) continue;
+
+        drv_socket_connection_stats_t* pConnectionStats = &pSocket->connectionStats[nIndex];
+        ESP_LOGI(TAG, "  %s[%d] In:%llu B(%u B/s)|Pkt:%u|Calls:%u|Again:%u|PushFail:%u|Drops:%u Out:%llu B(%u B/s)|Pkt:%u|Calls:%u|Again:%u|Short:%u",
+            pSocket->cName, nIndex,
+            (unsigned long long)pConnectionStats->u64BytesIn, (unsigned)socket_stats_rate(pConnectionStats->u64BytesIn, pConnectionStats->nStartTimeUs, nTimeUs),
+            (unsigned)pConnectionStats->u32PacketsIn, (unsigned)pConnectionStats->u32RecvCalls, (unsigned)pConnectionStats->u32RecvAgain, (unsigned)pConnectionStats->u32PushFail, (unsigned)pConnectionStats->u32RecvDrops,
+            (unsigned long long)pConnectionStats->u64BytesOut, (unsigned)socket_stats_rate(pConnectionStats->u64BytesOut, pConnectionStats->nStartTimeUs, nTimeUs),
+            (unsigned)pConnectionStats->u32PacketsOut, (unsigned)pConnectionStats->u32SendCalls, (unsigned)pConnectionStats->u32SendAgain, (unsigned)pConnectionStats->u32SendShort);
+        socket_latency_print(pSocket, nIndex);
+    }
+}
+
+/* pSocket NULL - all sockets in list */
+void drv_socket_stats(drv_socket_t* pSocket, bool bReset)
+{
+    drv_socket_t* apSocket[DRV_SOCKET_COUNT_MAX];
+    drv_socket_runtime_t* apRuntime[DRV_SOCKET_COUNT_MAX];
+    int nCount = socket_list_pin(pSocket, apSocket, apRuntime);
+
+    for (int index = 0; index < nCount; index++)
+    {
+        socket_stats_print(apSocket[index]);
+        if (bReset)
+        {
+            socket_stats_reset(apSocket[index]);
+        }
+        socket_runtime_put(apRuntime[index]);
+    }
+}
+
 int drv_socket_get_position(const char* name)
 {
     int result = -1;
+    taskENTER_CRITICAL(&socket_list_lock);
     for (int index = 0; index < nSocketListCount; index++)
     {
         if (pSocketList[index] != NULL)
@@ -140,12 +338,14 @@ int drv_socket_get_position(const char* name)
             }
         }
     }
+    taskEXIT_CRITICAL(&socket_list_lock);
     return result;
 }
 
 drv_socket_t* drv_socket_get_handle(const char* name)
 {
     drv_socket_t* result = NULL;
+    taskENTER_CRITICAL(&socket_list_lock);
     for (int index = 0; index < nSocketListCount; index++)
     {
         if (pSocketList[index] != NULL)
@@ -157,16 +357,364 @@ drv_socket_t* drv_socket_get_handle(const char* name)
             }
         }
     }
+    taskEXIT_CRITICAL(&socket_list_lock);
     return result;
 }
 
+/* *****************************************************************************
+ * Timers - min-heap of the socket deadlines
+ **************************************************************************** */
+bool socket_timer_before(drv_socket_timers_t* pTimers, int nPositionA, int nPositionB)
+{
+    return (int32_t)(pTimers->anDeadline[pTimers->au16Heap[nPositionA]] - pTimers->anDeadline[pTimers->au16Heap[nPositionB]]) < 0;
+}
+
+void socket_timer_swap(drv_socket_timers_t* pTimers, int nPositionA, int nPositionB)
+{
+    uint16_t u16Timer = pTimers->au16Heap[nPositionA];
+    pTimers->au16Heap[nPositionA] = pTimers->au16Heap[nPositionB];
+    pTimers->au16Heap[nPositionB] = u16Timer;
+    pTimers->anHeapPosition[pTimers->au16Heap[nPositionA]] = nPositionA;
+    pTimers->anHeapPosition[pTimers->au16Heap[nPositionB]] = nPositionB;
+}
+
+void socket_timer_sift(drv_socket_timers_t* pTimers, int nPosition)
+{
+    while ((nPosition > 0) && socket_timer_before(pTimers, nPosition, (nPosition - 1) / 2))
+    {
+        socket_timer_swap(pTimers, nPosition, (nPosition - 1) / 2);
+        nPosition = (nPosition - 1) / 2;
+    }
+    while (1)
+    {
+        int nChild = 2 * nPosition + 1;
+        if (nChild >= pTimers->nHeapCount) break;
+        if (((nChild + 1) < pTimers->nHeapCount) && socket_timer_before(pTimers, nChild + 1, nChild)) nChild++;
+        if (socket_timer_before(pTimers, nChild, nPosition) == false) break;
+        socket_timer_swap(pTimers, nPosition, nChild);
+        nPosition = nChild;
+    }
+}
+
+void socket_timer_init(drv_socket_t* pSocket)
+{
+    drv_socket_timers_t* pTimers = &pSocket->pRuntime->timers;
+
+    pTimers->nHeapCount = 0;
+    for (int nTimer = 0; nTimer < DRV_SOCKET_TIMER_COUNT; nTimer++)
+    {
+        pTimers->anHeapPosition[nTimer] = -1;
+        pTimers->abFired[nTimer] = false;
+    }
+}
+
+void socket_timer_stop(drv_socket_t* pSocket, int nTimer)
+{
+    drv_socket_timers_t* pTimers = &pSocket->pRuntime->timers;
+    int nPosition = pTimers->anHeapPosition[nTimer];
+
+    pTimers->abFired[nTimer] = false;
+    if (nPosition < 0) return;
+
+    pTimers->nHeapCount--;
+    if (nPosition != pTimers->nHeapCount)
+    {
+        socket_timer_swap(pTimers, nPosition, pTimers->nHeapCount);
+        pTimers->anHeapPosition[nTimer] = -1;
+        socket_timer_sift(pTimers, nPosition);
+    }
+    pTimers->anHeapPosition[nTimer] = -1;
+}
+
+/* (re)start a timer - expires nDelayTicks from now */
+void socket_timer_start(drv_socket_t* pSocket, int nTimer, TickType_t nDelayTicks)
+{
+    drv_socket_timers_t* pTimers = &pSocket->pRuntime->timers;
+    int nPosition = pTimers->anHeapPosition[nTimer];
+
+    pTimers->abFired[nTimer] = false;
+    pTimers->anDeadline[nTimer] = xTaskGetTickCount() + nDelayTicks;
+    if (nPosition < 0)
+    {
+        nPosition = pTimers->nHeapCount++;
+        pTimers->au16Heap[nPosition] = nTimer;
+        pTimers->anHeapPosition[nTimer] = nPosition;
+    }
+    socket_timer_sift(pTimers, nPosition);
+}
+
+bool socket_timer_running(drv_socket_t* pSocket, int nTimer)
+{
+    return pSocket->pRuntime->timers.anHeapPosition[nTimer] >= 0;
+}
+
+/* timer deadline reached - stays expired until restarted or stopped */
+bool socket_timer_expired(drv_socket_t* pSocket, int nTimer)
+{
+    drv_socket_timers_t* pTimers = &pSocket->pRuntime->timers;
+
+    if (pTimers->abFired[nTimer]) return true;
+    if (pTimers->anHeapPosition[nTimer] < 0) return false;
+    return (int32_t)(xTaskGetTickCount() - pTimers->anDeadline[nTimer]) >= 0;
+}
+
+/* move the expired timers out of the heap (the loop does not wake up again for them) */
+void socket_timer_process(drv_socket_t* pSocket)
+{
+    drv_socket_timers_t* pTimers = &pSocket->pRuntime->timers;
+    TickType_t nTickNow = xTaskGetTickCount();
+
+    while ((pTimers->nHeapCount > 0) && ((int32_t)(nTickNow - pTimers->anDeadline[pTimers->au16Heap[0]]) >= 0))
+    {
+        int nTimer = pTimers->au16Heap[0];
+        socket_timer_stop(pSocket, nTimer);
+        pTimers->abFired[nTimer] = true;
+    }
+}
+
+/* ticks until the nearest deadline (nMaxTicks if none) */
+TickType_t socket_timer_wait_ticks(drv_socket_t* pSocket, TickType_t nMaxTicks)
+{
+    drv_socket_timers_t* pTimers = &pSocket->pRuntime->timers;
+
+    if (pTimers->nHeapCount == 0) return nMaxTicks;
+
+    int32_t nTicksLeft = (int32_t)(pTimers->anDeadline[pTimers->au16Heap[0]] - xTaskGetTickCount());
+    if (nTicksLeft <= 0) return 0;
+    if ((TickType_t)nTicksLeft < nMaxTicks) return nTicksLeft;
+    return nMaxTicks;
+}
+
+/* all slots free - called with no open connections */
+void socket_connection_list_init(drv_socket_t* pSocket)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+
+    pSocket->nSocketConnectionsCount = 0;
+    for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
+    {
+        pSocket->nSocketIndexPrimer[nIndex] = -1;
+        pRuntime->anSlotNextFree[nIndex] = (nIndex + 1 < DRV_SOCKET_SERVER_MAX_CLIENTS) ? (nIndex + 1) : -1;
+    }
+    pRuntime->nSlotFreeHead = 0;
+}
+
+/* runtime for other tasks - NULL if not started, else not freed until socket_runtime_put() */
+drv_socket_runtime_t* socket_runtime_get(drv_socket_t* pSocket)
+{
+    taskENTER_CRITICAL(&socket_runtime_lock);
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    if (pRuntime != NULL)
+    {
+        pRuntime->u8Users++;
+    }
+    taskEXIT_CRITICAL(&socket_runtime_lock);
+    return pRuntime;
+}
+
+void socket_runtime_put(drv_socket_runtime_t* pRuntime)
+{
+    taskENTER_CRITICAL(&socket_runtime_lock);
+    pRuntime->u8Users--;
+    taskEXIT_CRITICAL(&socket_runtime_lock);
+}
+
+/* running sockets of the list (pSocket or all if NULL) with their runtimes pinned under the list lock - put each runtime after use */
+int socket_list_pin(drv_socket_t* pSocket, drv_socket_t** apSocket, drv_socket_runtime_t** apRuntime)
+{
+    int nCount = 0;
+
+    taskENTER_CRITICAL(&socket_list_lock);
+    for (int nIndex = 0; nIndex < nSocketListCount; nIndex++)
+    {
+        drv_socket_t* pSocketItem = pSocketList[nIndex];
+        if ((pSocketItem == NULL) || ((pSocket != NULL) && (pSocket != pSocketItem))) continue;
+
+        drv_socket_runtime_t* pRuntime = socket_runtime_get(pSocketItem);
+        if (pRuntime != NULL)
+        {
+            apSocket[nCount] = pSocketItem;
+            apRuntime[nCount++] = pRuntime;
+        }
+    }
+    taskEXIT_CRITICAL(&socket_list_lock);
+    return nCount;
+}
+
+/* serving task - publish the initialized runtime */
+void socket_runtime_attach(drv_socket_t* pSocket, drv_socket_runtime_t* pRuntime)
+{
+    taskENTER_CRITICAL(&socket_runtime_lock);
+    pRuntime->u8Users = 0;
+    pSocket->pRuntime = pRuntime;
+    taskEXIT_CRITICAL(&socket_runtime_lock);
+}
+
+/* serving task - detach the runtime and wait for the other tasks still using it */
+void socket_runtime_release(drv_socket_t* pSocket, drv_socket_runtime_t* pRuntime)
+{
+    bool bUsed;
+
+    taskENTER_CRITICAL(&socket_runtime_lock);
+    pSocket->pRuntime = NULL;
+    taskEXIT_CRITICAL(&socket_runtime_lock);
+
+    do
+    {
+        taskENTER_CRITICAL(&socket_runtime_lock);
+        bUsed = (pRuntime->u8Users > 0);
+        taskEXIT_CRITICAL(&socket_runtime_lock);
+        if (bUsed)
+        {
+            vTaskDelay(1);
+        }
+    }while(bUsed);
+}
+
+drv_socket_connection_id_t drv_socket_get_connection_id(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    drv_socket_connection_id_t nConnectionId = DRV_SOCKET_CONNECTION_ID_INVALID;
+
+    if ((nConnectionIndex < 0) || (nConnectionIndex >= DRV_SOCKET_SERVER_MAX_CLIENTS)) return DRV_SOCKET_CONNECTION_ID_INVALID;
+
+    drv_socket_runtime_t* pRuntime = socket_runtime_get(pSocket);
+    if (pRuntime == NULL) return DRV_SOCKET_CONNECTION_ID_INVALID;
+    if (pSocket->nSocketIndexPrimer[nConnectionIndex] >= 0)
+    {
+        nConnectionId = DRV_SOCKET_CONNECTION_ID(pRuntime->connection[nConnectionIndex].u16Generation, nConnectionIndex);
+    }
+    socket_runtime_put(pRuntime);
+    return nConnectionId;
+}
+
+/* connection index (slot) of a connection id or -1 if the connection is closed meanwhile */
+int drv_socket_get_connection_index(drv_socket_t* pSocket, drv_socket_connection_id_t nConnectionId)
+{
+    int nConnectionIndex = DRV_SOCKET_CONNECTION_INDEX(nConnectionId);
+
+    if (drv_socket_get_connection_id(pSocket, nConnectionIndex) != nConnectionId) return -1;
+    return nConnectionIndex;
+}
+
+/* send enabled on the connection (identification done or not needed) */
+bool drv_socket_get_send_enable(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    bool bSendEnable = false;
+
+    if ((nConnectionIndex < 0) || (nConnectionIndex >= DRV_SOCKET_SERVER_MAX_CLIENTS)) return false;
+
+    drv_socket_runtime_t* pRuntime = socket_runtime_get(pSocket);
+    if (pRuntime == NULL) return false;
+    if (pSocket->nSocketIndexPrimer[nConnectionIndex] >= 0)
+    {
+        bSendEnable = pRuntime->connection[nConnectionIndex].bSendEnable;
+    }
+    socket_runtime_put(pRuntime);
+    return bSendEnable;
+}
+
+/* deprecated socket level handshake fields follow the connection updated last */
+void socket_connection_state_mirror(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    drv_socket_connection_t* pConnection = &pSocket->pRuntime->connection[nConnectionIndex];
+
+    pSocket->bSendEnable = pConnection->bSendEnable;
+    pSocket->bIndentifyNeeded = pConnection->bIndentifyNeeded;
+    pSocket->nPingCount = pConnection->nPingCount;
+}
+
+/* share of the send bandwidth of the connection against the other connections with pending data */
+bool drv_socket_set_send_weight(drv_socket_t* pSocket, drv_socket_connection_id_t nConnectionId, int nWeight)
+{
+    if ((nWeight < 1) || (nWeight > DRV_SOCKET_SEND_WEIGHT_MAX)) return false;
+
+    /* runtime kept first - the connection id is resolved against the generation of this runtime */
+    drv_socket_runtime_t* pRuntime = socket_runtime_get(pSocket);
+    if (pRuntime == NULL) return false;
+
+    int nConnectionIndex = drv_socket_get_connection_index(pSocket, nConnectionId);
+    if (nConnectionIndex >= 0)
+    {
+        pRuntime->connection[nConnectionIndex].u8SendWeight = nWeight;
+    }
+    socket_runtime_put(pRuntime);
+    return nConnectionIndex >= 0;
+}
+
+/* multipath client - the connections share the streams of index 0 and carry framed, sequenced data */
+bool socket_multipath_framed(drv_socket_t* pSocket)
+{
+    return (pSocket->multipath != DRV_SOCKET_MULTIPATH_OFF) && (pSocket->bServerType == false) && (pSocket->protocol_type == DRV_SOCKET_SOCK_STREAM);
+}
+
+/* stream index of a connection - the connections of a multipath client share the streams of index 0 */
+int socket_stream_index(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    if (socket_multipath_framed(pSocket)) return 0;
+    return nConnectionIndex;
+}
+
+/* streams in use - their connection is open (any connection of a multipath client) */
+bool socket_stream_open(drv_socket_t* pSocket, int nStreamIndex)
+{
+    if (socket_multipath_framed(pSocket)) return (nStreamIndex == 0) && (pSocket->nSocketConnectionsCount > 0);
+    return pSocket->nSocketIndexPrimer[nStreamIndex] >= 0;
+}
+
+/* the connection just added opens its streams - not a multipath connection joining the session */
+bool socket_stream_new(drv_socket_t* pSocket)
+{
+    return (socket_multipath_framed(pSocket) == false) || (pSocket->nSocketConnectionsCount == 1);
+}
+
+/* stream state of a new connection - a multipath session starts with a new session id and sequence 0 */
+void socket_stream_reset(drv_socket_t* pSocket, int nStreamIndex)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+
+    pRuntime->connection[nStreamIndex].bRecvPaused = false;
+    pRuntime->connection[nStreamIndex].bSendHigh = false;
+    pRuntime->connection[nStreamIndex].u32SendPulled = 0;
+    pRuntime->connection[nStreamIndex].u32RecvPushed = 0;
+    pRuntime->connection[nStreamIndex].sendMarks.u8Count = 0;
+    pRuntime->connection[nStreamIndex].recvMarks.u8Count = 0;
+    taskENTER_CRITICAL(&socket_runtime_lock);
+    pRuntime->connection[nStreamIndex].nSendEnqueueUs = 0;
+    taskEXIT_CRITICAL(&socket_runtime_lock);
+    socket_latency_reset(pSocket, nStreamIndex);
+
+    if (socket_multipath_framed(pSocket))
+    {
+        pRuntime->u32FrameSession = esp_random();
+        pRuntime->u32FrameSendSeq = 0;
+        pRuntime->u32FrameRecvSeq = 0;
+    }
+}
+
 void socket_connection_remove_from_list(drv_socket_t* pSocket, int nConnectionIndex)
 {
-    for (int nIndex = nConnectionIndex + 1 ; nIndex < pSocket->nSocketConnectionsCount ; nIndex++)
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    drv_socket_connection_t* pConnection = &pRuntime->connection[nConnectionIndex];
+
+    if (pSocket->onConnectionClose != NULL)
     {
-        pSocket->nSocketIndexPrimer[nIndex - 1] = pSocket->nSocketIndexPrimer[nIndex];
+        pSocket->onConnectionClose(DRV_SOCKET_CONNECTION_ID(pConnection->u16Generation, nConnectionIndex));
     }
 
+    socket_timer_stop(pSocket, DRV_SOCKET_TIMER_PING + nConnectionIndex);
+    socket_timer_stop(pSocket, DRV_SOCKET_TIMER_IDENTIFY + nConnectionIndex);
+    socket_timer_stop(pSocket, DRV_SOCKET_TIMER_COALESCE + nConnectionIndex);
+    socket_ack_fail(pSocket, nConnectionIndex);
+    socket_multipath_remove(pSocket, nConnectionIndex);
+
+    /* unsent staged data belongs to the closed connection - keep only the buffer */
+    pConnection->nSendBufferOffset = 0;
+    pConnection->nSendBufferLength = 0;
+    pConnection->u16Generation++;       /* ids of the closed connection become stale */
+
+    pRuntime->anSlotNextFree[nConnectionIndex] = pRuntime->nSlotFreeHead;
+    pRuntime->nSlotFreeHead = nConnectionIndex;
+
     pSocket->nSocketConnectionsCount--;
 
     if (pSocket->nSocketConnectionsCount==0)
@@ -182,20 +730,47 @@ void socket_connection_remove_from_list(drv_socket_t* pSocket, int nConnectionIn
     }
 }
 
-bool socket_connection_add_to_list(drv_socket_t* pSocket, int nSocketIndex)
+/* returns the connection index (slot) of the added connection or -1 */
+int socket_connection_add_to_list(drv_socket_t* pSocket, int nSocketIndex)
 {
-    if (pSocket->nSocketConnectionsCount < DRV_SOCKET_SERVER_MAX_CLIENTS)
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    int nConnectionIndex = pRuntime->nSlotFreeHead;
+
+    if (nConnectionIndex >= 0)
     {
-        pSocket->nSocketIndexPrimer[pSocket->nSocketConnectionsCount] = nSocketIndex;
-        socket_set_options(pSocket, pSocket->nSocketConnectionsCount);
-        socket_on_connect(pSocket, pSocket->nSocketConnectionsCount);
+        pRuntime->nSlotFreeHead = pRuntime->anSlotNextFree[nConnectionIndex];
+        pRuntime->anSlotNextFree[nConnectionIndex] = -1;
+
+        pSocket->nSocketIndexPrimer[nConnectionIndex] = nSocketIndex;
+        bzero((void*)&pSocket->nSocketIndexPrimerIP[nConnectionIndex], sizeof(pSocket->nSocketIndexPrimerIP[nConnectionIndex]));
         pSocket->nSocketConnectionsCount++;
-        return true;
+        pRuntime->connection[nConnectionIndex].nSendDeficit = 0;
+        pRuntime->connection[nConnectionIndex].u8SendWeight = 1;
+        pRuntime->connection[nConnectionIndex].bCoalesceFlush = false;
+        memset(&pSocket->connectionStats[nConnectionIndex], 0, sizeof(pSocket->connectionStats[nConnectionIndex]));
+        pSocket->connectionStats[nConnectionIndex].nStartTimeUs = esp_timer_get_time();
+        bzero((void*)pRuntime->connection[nConnectionIndex].au32LanePulled, sizeof(pRuntime->connection[nConnectionIndex].au32LanePulled));
+        pRuntime->connection[nConnectionIndex].nStagedLane = -1;
+        pRuntime->connection[nConnectionIndex].u8AckMarkCount = 0;
+        if (socket_stream_new(pSocket))
+        {
+            socket_stream_reset(pSocket, socket_stream_index(pSocket, nConnectionIndex));
+        }
+        pSocket->stats.u32Connects++;
+        socket_set_options(pSocket, nConnectionIndex);
+        socket_on_connect(pSocket, nConnectionIndex);
+
+        if (pSocket->onConnectionOpen != NULL)
+        {
+            pSocket->onConnectionOpen(DRV_SOCKET_CONNECTION_ID(pRuntime->connection[nConnectionIndex].u16Generation, nConnectionIndex));
+        }
+        return nConnectionIndex;
     }
     else
     {
         ESP_LOGE(TAG, "Connecting Failure (Max Clients Reached) client to socket %s %d", pSocket->cName, nSocketIndex);
-        return false;
+        pSocket->stats.u32AcceptRejects++;
+        return -1;
     }
 }
 
@@ -204,7 +779,7 @@ void socket_disconnect_connection(drv_socket_t* pSocket, int nConnectionIndex)
 {
     int err;
 
-    if (nConnectionIndex < pSocket->nSocketConnectionsCount)
+    if ((nConnectionIndex >= 0) && (nConnectionIndex < DRV_SOCKET_SERVER_MAX_CLIENTS) && (pSocket->nSocketIndexPrimer[nConnectionIndex] >= 0))
     {
         ESP_LOGE(TAG, "Disconnecting client %d socket %s %d", nConnectionIndex, pSocket->cName, pSocket->nSocketIndexPrimer[nConnectionIndex]);
         if(shutdown(pSocket->nSocketIndexPrimer[nConnectionIndex], SHUT_RDWR) != 0)
@@ -223,15 +798,106 @@ void socket_disconnect_connection(drv_socket_t* pSocket, int nConnectionIndex)
 }
 
 
+/* reconnect delay back to the initial value (after a successful connect) */
+void socket_reconnect_time_reset(drv_socket_t* pSocket)
+{
+    int nReconnectTimeMinMs = pSocket->nReconnectTimeMinMs;
+    if (nReconnectTimeMinMs <= 0)
+    {
+        nReconnectTimeMinMs = DRV_SOCKET_RECONNECT_TIME_MS;
+    }
+    pSocket->pRuntime->nReconnectDelayTicks = pdMS_TO_TICKS(nReconnectTimeMinMs);
+}
+
+/* schedule the next connect attempt - exponential backoff with random jitter (delay/2 .. delay) */
+void socket_reconnect_time_start(drv_socket_t* pSocket)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+
+    int nReconnectTimeMaxMs = pSocket->nReconnectTimeMaxMs;
+    if (nReconnectTimeMaxMs <= 0)
+    {
+        nReconnectTimeMaxMs = DRV_SOCKET_RECONNECT_TIME_MAX_MS;
+    }
+    TickType_t nReconnectDelayMaxTicks = pdMS_TO_TICKS(nReconnectTimeMaxMs);
+
+    TickType_t nDelayTicks = pRuntime->nReconnectDelayTicks;
+    if (nDelayTicks > nReconnectDelayMaxTicks)
+    {
+        nDelayTicks = nReconnectDelayMaxTicks;
+    }
+    TickType_t nJitterTicks = nDelayTicks - (nDelayTicks / 2);
+    if (nJitterTicks > 0)
+    {
+        nDelayTicks = (nDelayTicks / 2) + (esp_random() % (nJitterTicks + 1));
+    }
+
+    socket_timer_start(pSocket, DRV_SOCKET_TIMER_RECONNECT, nDelayTicks);
+    pSocket->stats.u32Reconnects++;
+
+    if (pRuntime->nReconnectDelayTicks < (nReconnectDelayMaxTicks / 2))
+    {
+        pRuntime->nReconnectDelayTicks *= 2;
+    }
+    else
+    {
+        pRuntime->nReconnectDelayTicks = nReconnectDelayMaxTicks;
+    }
+    ESP_LOGI(TAG, "Socket %s reconnect in %d ms", pSocket->cName, (int)(nDelayTicks * portTICK_PERIOD_MS));
+}
+
+bool socket_reconnect_time_elapsed(drv_socket_t* pSocket)
+{
+    if (socket_timer_expired(pSocket, DRV_SOCKET_TIMER_RECONNECT))
+    {
+        socket_timer_stop(pSocket, DRV_SOCKET_TIMER_RECONNECT);
+    }
+    return socket_timer_running(pSocket, DRV_SOCKET_TIMER_RECONNECT) == false;
+}
+
+void socket_connect_attempt_close(drv_socket_t* pSocket, drv_socket_connect_t* pConnect)
+{
+    if (pConnect->nSocket >= 0)
+    {
+        ESP_LOGW(TAG, "Closing connect attempt socket %s %d", pSocket->cName, pConnect->nSocket);
+        close(pConnect->nSocket);
+        pConnect->nSocket = -1;
+    }
+    pConnect->bInProgress = false;
+    socket_timer_stop(pSocket, pConnect->nTimer);
+}
+
+/* end make-before-break failover - the current connection stays on its interface */
+void socket_failover_stop(drv_socket_t* pSocket)
+{
+    socket_connect_attempt_close(pSocket, &pSocket->pRuntime->failover);
+    if (pSocket->pRuntime->nFailoverSocket >= 0)
+    {
+        close(pSocket->pRuntime->nFailoverSocket);
+        pSocket->pRuntime->nFailoverSocket = -1;
+    }
+    socket_timer_stop(pSocket, DRV_SOCKET_TIMER_FAILOVER_DRAIN);
+    socket_timer_stop(pSocket, DRV_SOCKET_TIMER_FAILOVER_POLL);
+    pSocket->pRuntime->nFailoverInterfaceIndex = -1;
+}
+
+/* end the secondary connect attempt - an open secondary is closed with the other connections, without promotion */
+void socket_multipath_stop(drv_socket_t* pSocket)
+{
+    socket_connect_attempt_close(pSocket, &pSocket->pRuntime->multipath);
+    pSocket->pRuntime->nMultipathIndex = -1;
+    socket_timer_stop(pSocket, DRV_SOCKET_TIMER_MULTIPATH_STEER);
+}
+
 void socket_disconnect(drv_socket_t* pSocket)
 {
     int err;
 
     if (pSocket->bServerType)
     {
-        while (pSocket->nSocketConnectionsCount)
+        for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
         {
-            socket_disconnect_connection(pSocket, 0);   /* Start Removing From Socket Client Connection Index 0 */
+            socket_disconnect_connection(pSocket, nIndex);
         }
         if (pSocket->nSocketIndexServer >= 0)
         {
@@ -251,12 +917,17 @@ void socket_disconnect(drv_socket_t* pSocket)
     }
     else
     {
-        while (pSocket->nSocketConnectionsCount)
+        socket_connect_attempt_close(pSocket, &pSocket->pRuntime->connect);
+        socket_failover_stop(pSocket);
+        socket_multipath_stop(pSocket);
+        socket_race_stop(pSocket);
+        for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
         {
-            socket_disconnect_connection(pSocket, 0);   /* Start Removing From Socket Client Connection Index 0 */
+            if (pSocket->nSocketIndexPrimer[nIndex] < 0) continue;
+            socket_disconnect_connection(pSocket, nIndex);
             if (pSocket->onDisconnect != NULL)
             {
-                pSocket->onDisconnect(0);
+                pSocket->onDisconnect(nIndex);
             }
         }
         
@@ -279,28 +950,130 @@ void socket_disconnect(drv_socket_t* pSocket)
     pSocket->bConnected = false;
 }
 
-void drv_socket_disconnect(drv_socket_t* pSocket)
+void socket_wakeup_send(drv_socket_wakeup_t* pWakeup)
 {
-    pSocket->bDisconnectRequest = true;
-}
+    bool bSend = false;
 
-void drv_socket_url_set(drv_socket_t* pSocket, const char* url)
-{
-    if (url == NULL)
+    taskENTER_CRITICAL(&socket_runtime_lock);
+    if ((pWakeup->nSocket >= 0) && (pWakeup->bPending == false))
     {
-        memset(pSocket->cURL, 0, sizeof(pSocket->cURL));
-        ESP_LOGI(TAG, "Socket %s set empty URL '%s' Success", pSocket->cName, pSocket->cURL);
+        pWakeup->bPending = true;       /* one queued datagram wakes the task */
+        bSend = true;
     }
-    else
-    if (strlen(url) < sizeof(pSocket->cURL))
+    taskEXIT_CRITICAL(&socket_runtime_lock);
+
+    if (bSend)
     {
-        strcpy(pSocket->cURL, url);
-        ESP_LOGI(TAG, "Socket %s set URL '%s' Success", pSocket->cName, pSocket->cURL);
-        pSocket->bDisconnectRequest = true;     /* reset socket in order changes to take effect */
+        uint8_t u8Wakeup = 0;
+        if (sendto(pWakeup->nSocket, &u8Wakeup, sizeof(u8Wakeup), MSG_DONTWAIT, (struct sockaddr *)&pWakeup->addr, sizeof(pWakeup->addr)) < 0)
+        {
+            /* not queued (ENOMEM, full queue) - the next wakeup sends again */
+            taskENTER_CRITICAL(&socket_runtime_lock);
+            pWakeup->bPending = false;
+            taskEXIT_CRITICAL(&socket_runtime_lock);
+        }
     }
-    else
-    {
-        ESP_LOGE(TAG, "Socket %s set URL '%s' Failure (new string size must fit %d bytes)", pSocket->cName, url, sizeof(pSocket->cURL));
+}
+
+void drv_socket_wakeup(drv_socket_t* pSocket)
+{
+    drv_socket_runtime_t* pRuntime = socket_runtime_get(pSocket);
+
+    if (pRuntime == NULL) return;
+    socket_latency_enqueued(pSocket, pRuntime);
+    if (pRuntime->pWakeup != NULL)
+    {
+        socket_wakeup_send(pRuntime->pWakeup);
+    }
+    socket_runtime_put(pRuntime);
+}
+
+/* multipath client - queue one frame (whole or nothing) in pSendStreamBuffer[0], the single producer of the stream */
+bool drv_socket_frame_send(drv_socket_t* pSocket, const uint8_t* pData, int nLength, bool bCritical)
+{
+    uint8_t au8Header[DRV_SOCKET_FRAME_QUEUE_HEADER_SIZE];
+
+    if ((pSocket == NULL) || (socket_multipath_framed(pSocket) == false)) return false;
+    if ((nLength <= 0) || (nLength > DRV_SOCKET_FRAME_PAYLOAD_MAX)) return false;
+
+    StreamBufferHandle_t* pStream = pSocket->pSendStreamBuffer[0];
+    if ((pStream == NULL) || (drv_stream_get_free(pStream) < (DRV_SOCKET_FRAME_QUEUE_HEADER_SIZE + nLength))) return false;
+
+    au8Header[0] = (uint8_t)(nLength >> 8);
+    au8Header[1] = (uint8_t)nLength;
+    au8Header[2] = bCritical ? DRV_SOCKET_FRAME_FLAG_CRITICAL : 0;
+    drv_stream_push(pStream, au8Header, sizeof(au8Header));
+    drv_stream_push(pStream, (uint8_t*)pData, nLength);
+    drv_socket_wakeup(pSocket);
+    return true;
+}
+
+/* url of the socket or of one of its endpoints */
+bool socket_uses_url(drv_socket_t* pSocket, const char* pURL)
+{
+    if (strcmp(pSocket->cURL, pURL) == 0) return true;
+    for (int nIndex = 0; nIndex < pSocket->nEndpointCount; nIndex++)
+    {
+        if (strcmp(pSocket->endpoint[nIndex].cHost, pURL) == 0) return true;
+    }
+    return false;
+}
+
+/* wake the sockets in list (pURL NULL - all, else the sockets using the url) - for the event and resolver tasks */
+void socket_list_wakeup(const char* pURL)
+{
+    drv_socket_runtime_t* apRuntime[DRV_SOCKET_COUNT_MAX];
+    int nCount = 0;
+
+    /* runtimes pinned under the list lock - the sockets can be stopped meanwhile */
+    taskENTER_CRITICAL(&socket_list_lock);
+    for (int nIndex = 0; nIndex < nSocketListCount; nIndex++)
+    {
+        drv_socket_t* pSocket = pSocketList[nIndex];
+        if ((pSocket == NULL) || ((pURL != NULL) && (socket_uses_url(pSocket, pURL) == false))) continue;
+
+        drv_socket_runtime_t* pRuntime = socket_runtime_get(pSocket);
+        if (pRuntime != NULL)
+        {
+            apRuntime[nCount++] = pRuntime;
+        }
+    }
+    taskEXIT_CRITICAL(&socket_list_lock);
+
+    for (int nIndex = 0; nIndex < nCount; nIndex++)
+    {
+        if (apRuntime[nIndex]->pWakeup != NULL)
+        {
+            socket_wakeup_send(apRuntime[nIndex]->pWakeup);
+        }
+        socket_runtime_put(apRuntime[nIndex]);
+    }
+}
+
+void drv_socket_disconnect(drv_socket_t* pSocket)
+{
+    pSocket->bDisconnectRequest = true;
+    drv_socket_wakeup(pSocket);
+}
+
+void drv_socket_url_set(drv_socket_t* pSocket, const char* url)
+{
+    if (url == NULL)
+    {
+        memset(pSocket->cURL, 0, sizeof(pSocket->cURL));
+        ESP_LOGI(TAG, "Socket %s set empty URL '%s' Success", pSocket->cName, pSocket->cURL);
+    }
+    else
+    if (strlen(url) < sizeof(pSocket->cURL))
+    {
+        strcpy(pSocket->cURL, url);
+        ESP_LOGI(TAG, "Socket %s set URL '%s' Success", pSocket->cName, pSocket->cURL);
+        pSocket->bDisconnectRequest = true;     /* reset socket in order changes to take effect */
+        drv_socket_wakeup(pSocket);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Socket %s set URL '%s' Failure (new string size must fit %u bytes)", pSocket->cName, url, (unsigned)sizeof(pSocket->cURL));
     }
 }
 
@@ -317,21 +1090,62 @@ void drv_socket_ip_address_set(drv_socket_t* pSocket, const char* ip_address)
         strcpy(pSocket->cHostIP, ip_address);
         ESP_LOGI(TAG, "Socket %s set IP address %s Success", pSocket->cName, pSocket->cHostIP);
         pSocket->bDisconnectRequest = true;     /* reset socket in order changes to take effect */
+        drv_socket_wakeup(pSocket);
     }
     else
     {
-        ESP_LOGE(TAG, "Socket %s set IP address %s Failure (new string size must fit %d bytes)", pSocket->cName, ip_address, sizeof(pSocket->cHostIP));
+        ESP_LOGE(TAG, "Socket %s set IP address %s Failure (new string size must fit %u bytes)", pSocket->cName, ip_address, (unsigned)sizeof(pSocket->cHostIP));
+    }
+}
+
+/* add an endpoint (URL or IPv4 address) - endpoints are raced in order of addition, the last successful one first */
+bool drv_socket_endpoint_add(drv_socket_t* pSocket, const char* host, uint16_t port)
+{
+    if ((host == NULL) || (strlen(host) >= sizeof(pSocket->endpoint[0].cHost)))
+    {
+        ESP_LOGE(TAG, "Socket %s add endpoint Failure (host must fit %u bytes)", pSocket->cName, (unsigned)sizeof(pSocket->endpoint[0].cHost));
+        return false;
+    }
+    if (pSocket->pTask != NULL)
+    {
+        /* endpoint[] read by the serving task without a lock */
+        ESP_LOGE(TAG, "Socket %s add endpoint %s Failure (socket task running - stop it first)", pSocket->cName, host);
+        return false;
+    }
+    if (pSocket->nEndpointCount >= DRV_SOCKET_ENDPOINT_COUNT_MAX)
+    {
+        ESP_LOGE(TAG, "Socket %s add endpoint %s Failure (max %d endpoints)", pSocket->cName, host, DRV_SOCKET_ENDPOINT_COUNT_MAX);
+        return false;
+    }
+    strcpy(pSocket->endpoint[pSocket->nEndpointCount].cHost, host);
+    pSocket->endpoint[pSocket->nEndpointCount].u16Port = port;
+    pSocket->nEndpointCount++;
+    ESP_LOGI(TAG, "Socket %s add endpoint %s:%d Success", pSocket->cName, host, port);
+    return true;
+}
+
+bool drv_socket_endpoint_clear(drv_socket_t* pSocket)
+{
+    if (pSocket->pTask != NULL)
+    {
+        /* endpoint[] read by the serving task without a lock - the endpoint winner is reset with the runtime on the next start */
+        ESP_LOGE(TAG, "Socket %s clear endpoints Failure (socket task running - stop it first)", pSocket->cName);
+        return false;
     }
+    pSocket->nEndpointCount = 0;
+    return true;
 }
 
 void drv_socket_stop(drv_socket_t* pSocket)
 {
     pSocket->bConnectDeny = true;
+    drv_socket_wakeup(pSocket);
 }
 
 void drv_socket_start(drv_socket_t* pSocket)
 {
     pSocket->bConnectDeny = false;
+    drv_socket_wakeup(pSocket);
 }
 
 
@@ -441,994 +1255,2853 @@ bool socket_identification_answer(drv_socket_t* pSocket, int nConnectionIndex, c
 
 
 
-void socket_recv(drv_socket_t* pSocket, int nConnectionIndex)
+StreamBufferHandle_t* socket_send_lane_stream(drv_socket_t* pSocket, int nLane, int nConnectionIndex)
 {
-    int err;
-    int nSocketClient;
-    char sockTypeString[10];
-
-    nSocketClient = pSocket->nSocketIndexPrimer[nConnectionIndex];
-    if (pSocket->bServerType)
+    switch (nLane)
     {
-        strcpy(sockTypeString, "client");
+        case DRV_SOCKET_SEND_LANE_CONTROL:
+            return pSocket->pSendStreamBufferControl[nConnectionIndex];
+        case DRV_SOCKET_SEND_LANE_BULK:
+            return pSocket->pSendStreamBufferBulk[nConnectionIndex];
+        default:
+            return pSocket->pSendStreamBuffer[nConnectionIndex];
     }
-    else
+}
+
+/* highest priority send lane with data or -1 */
+int socket_send_lane_select(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    for (int nLane = 0; nLane < DRV_SOCKET_SEND_LANE_COUNT; nLane++)
     {
-        strcpy(sockTypeString, "");
+        StreamBufferHandle_t* pStream = socket_send_lane_stream(pSocket, nLane, nConnectionIndex);
+        if ((pStream != NULL) && (drv_stream_get_size(pStream) > 0)) return nLane;
     }
+    return -1;
+}
 
-    #define MAX_TCP_READ_SIZE CONFIG_DRV_SOCKET_MAX_TCP_READ_SIZE
-
-    int nLength = MAX_TCP_READ_SIZE;
-    int nLengthPushSize = 0;
-    int nLengthPushFree;
-    uint8_t* au8Temp;
+/* *****************************************************************************
+ * Watermarks - receive pause and send throttle notifications
+ **************************************************************************** */
+int socket_recv_watermark(drv_socket_t* pSocket, int nConnectionIndex, bool bHigh)
+{
+    int nWatermark = bHigh ? pSocket->nRecvHighWatermark : pSocket->nRecvLowWatermark;
+    if (nWatermark > 0) return nWatermark;
 
-    if (pSocket->bPreventOverflowReceivedData)
-    {
-        //nLengthPushSize = xStreamBufferBytesAvailable(*pSocket->pRecvStreamBuffer[nConnectionIndex]);
-        //nLengthPushFree = xStreamBufferSpacesAvailable(*pSocket->pRecvStreamBuffer[nConnectionIndex]);
-        nLengthPushSize = drv_stream_get_size(pSocket->pRecvStreamBuffer[nConnectionIndex]);
-        nLengthPushFree = drv_stream_get_free(pSocket->pRecvStreamBuffer[nConnectionIndex]);
+    int nCapacity = drv_stream_get_size(pSocket->pRecvStreamBuffer[nConnectionIndex]) + drv_stream_get_free(pSocket->pRecvStreamBuffer[nConnectionIndex]);
+    if (bHigh && pSocket->bPreventOverflowReceivedData) return nCapacity;      /* deprecated flag - read until full as before */
+    return bHigh ? ((nCapacity * 3) / 4) : (nCapacity / 4);
+}
 
-        if (nLengthPushSize)
-        {
-            ESP_LOGW(TAG, "%s socket %s[%d] %d read buffer free %d bytes", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLengthPushFree);
-        }
-        
+void socket_recv_pause(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    drv_socket_connection_t* pConnection = &pSocket->pRuntime->connection[nConnectionIndex];
 
-        if (nLengthPushFree >= 0)
-        {
-            if(nLength > nLengthPushFree)
-            {
-                if (nLengthPushSize)
-                {
-                    ESP_LOGW(TAG, "Limit Read from %s socket %s[%d] %d because of issuficient read buffer (%d/%d bytes)", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLengthPushFree, nLength);
-                }
-                nLength = nLengthPushFree;
-            }
-        }
-        
+    if (pConnection->bRecvPaused) return;
+    pConnection->bRecvPaused = true;
+    ESP_LOGW(TAG, "socket %s[%d] receive paused (%d bytes queued)", pSocket->cName, nConnectionIndex, drv_stream_get_size(pSocket->pRecvStreamBuffer[nConnectionIndex]));
+    if (pSocket->onRecvWatermark != NULL)
+    {
+        pSocket->onRecvWatermark(nConnectionIndex, true);
     }
+    socket_timer_start(pSocket, DRV_SOCKET_TIMER_WATERMARK, pdMS_TO_TICKS(DRV_SOCKET_WATERMARK_POLL_TIME_MS));
+}
 
-    if (nLength == 0)
+/* connection not read - its receive stream is above the high watermark (or its next frame waits for the other multipath connection) */
+bool socket_recv_paused(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    return pSocket->pRuntime->connection[socket_stream_index(pSocket, nConnectionIndex)].bRecvPaused
+        || pSocket->pRuntime->connection[nConnectionIndex].bFrameParked;
+}
+
+/* bytes queued in all send lanes of the stream */
+int socket_send_queued_size(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    int nSize = 0;
+    for (int nLane = 0; nLane < DRV_SOCKET_SEND_LANE_COUNT; nLane++)
     {
-        ESP_LOGE(TAG, "Skip Read from %s socket %s[%d] %d because of full read buffer (%d bytes)", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLengthPushSize);
-        return;
+        StreamBufferHandle_t* pStream = socket_send_lane_stream(pSocket, nLane, nConnectionIndex);
+        if (pStream != NULL) nSize += drv_stream_get_size(pStream);
     }
-    
-    au8Temp = malloc(nLength);
+    return nSize;
+}
 
-    if (au8Temp)
-    {
-        if (pSocket->pRuntime->bBroadcastRxTx)
-        {
-            socklen_t socklen = sizeof(pSocket->pRuntime->host_addr_recv);
-            nLength = recvfrom(nSocketClient, au8Temp, nLength, MSG_PEEK | MSG_DONTWAIT, (struct sockaddr *)&pSocket->pRuntime->host_addr_recv, &socklen);
+/* compare the stream fill levels with the watermarks - polled while any of them is exceeded */
+void socket_watermark_periodic(drv_socket_t* pSocket)
+{
+    bool bPoll = false;
 
-        }
-        else
-        {
-            nLength = recv(nSocketClient, au8Temp, nLength, MSG_PEEK | MSG_DONTWAIT);
-        }
-        free(au8Temp);
-        
-        
+    for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
+    {
+        if (socket_stream_open(pSocket, nIndex) == false) continue;
+        drv_socket_connection_t* pConnection = &pSocket->pRuntime->connection[nIndex];
 
-        if (nLength > 0)
+        if (drv_stream_get_free(pSocket->pRecvStreamBuffer[nIndex]) >= 0)
         {
-            int nLengthPeek = nLength;
-
-            ESP_LOGD(TAG, "01 %d bytes Peek on %s socket", nLengthPeek, pSocket->cName);
-
-            au8Temp = malloc(nLength);
-
-            if (au8Temp)
+            int nSize = drv_stream_get_size(pSocket->pRecvStreamBuffer[nIndex]);
+            if (pConnection->bRecvPaused)
             {
-
-
-                if (pSocket->pRuntime->bBroadcastRxTx)
-                {
-                    socklen_t socklen = sizeof(pSocket->pRuntime->host_addr_recv);
-                    nLength = recvfrom(nSocketClient, au8Temp, nLength, MSG_DONTWAIT, (struct sockaddr *)&pSocket->pRuntime->host_addr_recv, &socklen);
-
-                    #define IP2STR_4(u32addr) ((uint8_t*)(&u32addr))[0],((uint8_t*)(&u32addr))[1],((uint8_t*)(&u32addr))[2],((uint8_t*)(&u32addr))[3]
-                    struct sockaddr_in *host_addr_recv_ip4 = (struct sockaddr_in *)&pSocket->pRuntime->host_addr_recv;
-                    char* adapter_interface_address = inet_ntoa(host_addr_recv_ip4->sin_addr.s_addr);
-                    ESP_LOGW(TAG, "Recv %s socket %s[%d] %d (host_addr_recv %s:%d)", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, adapter_interface_address, ntohs(host_addr_recv_ip4->sin_port));
-                    //ESP_LOGW(TAG, "host_addr_recv " IPSTR ":%d", IP2STR_4(host_addr_recv_ip4->sin_addr.s_addr), ntohs(host_addr_recv_ip4->sin_port));
-                    //ESP_LOGW(TAG, "host_addr_recv 0x%08X:%d", (int)(host_addr_recv_ip4->sin_addr.s_addr), ntohs(host_addr_recv_ip4->sin_port));
-
-                    uint32_t u32RecvFromIP;
-                    uint16_t u16RecvFromPort;
-
-                    u32RecvFromIP = host_addr_recv_ip4->sin_addr.s_addr;
-                    u16RecvFromPort = ntohs(host_addr_recv_ip4->sin_port);
-
-                    if (pSocket->onReceiveFrom != NULL)
-                    {
-                        pSocket->onReceiveFrom(u32RecvFromIP, u16RecvFromPort);
-                    }
-
-                }
-                else
+                if (nSize <= socket_recv_watermark(pSocket, nIndex, false))
                 {
-                    nLength = recv(nSocketClient, au8Temp, nLengthPeek, MSG_DONTWAIT);
-                }
-            
-                if (nLength > 0)
-                {
-                    if (nLength == nLengthPeek)
-                    {
-                        ESP_LOG_BUFFER_CHAR_LEVEL(pSocket->cName, au8Temp, nLength, ESP_LOG_DEBUG);
-
-                        if (pSocket->bIndentifyForced)
-                        {
-                            if(memcmp((char*)au8Temp,"man mac", strlen("man mac")) == 0)
-                            {
-                                socket_if_get_mac(pSocket, last_mac_addr_on_identification_request);
-                                ESP_LOGI(TAG, "Last MAC On Identification Request %02X:%02X:%02X:%02X:%02X:%02X", MAC2STR(last_mac_addr_on_identification_request));
-                                //drv_system_set_last_mac_identification_request(last_mac_addr_on_identification_request); To Do change to use this module instead drv_system
-                            }
-                        }
-
-                        if (pSocket->bIndentifyNeeded)
-                        {
-                            //ESP_LOG_BUFFER_CHAR(TAG "!!!!!!!!!!!!!!!!001", au8Temp, nLength);
-                            if (socket_identification_answer(pSocket, nConnectionIndex, (char*)au8Temp, nLength))
-                            {
-                                //ESP_LOG_BUFFER_CHAR(TAG "!!!!!!!!!!!!!!!!002", au8Temp, nLength);
-                                pSocket->bIndentifyNeeded = false;
-                                pSocket->bSendEnable = true;
-                            }
-                        }
-
-                        if (pSocket->bLineEndingFixCRLFToCR)
-                        {
-                            for (int i = 0; i < nLength; i++)
-                            {
-                                if (i > 0)
-                                {
-                                    if((au8Temp[i-1] == '\r') && (au8Temp[i] == '\n'))
-                                    {
-                                        nLength--;
-                                        for (int j = i; j < nLength; j++)
-                                        {
-                                            au8Temp[j] = au8Temp[j+1];
-                                        }
-                                    }
-                                    else
-                                    if((au8Temp[i-1] == '\n') && (au8Temp[i] == '\r'))
-                                    {
-                                        nLength--;
-                                        for (int j = i; j < nLength; j++)
-                                        {
-                                            au8Temp[j] = au8Temp[j+1];
-                                        }
-                                    }
-                                }
-                                
-                            }
-                        }
-
-                        if (pSocket->onReceive != NULL)
-                        {
-                            int nLengthAfterProcess = pSocket->onReceive(nConnectionIndex, (char*)au8Temp, nLength);
-
-                            if (nLengthAfterProcess != nLength)
-                            {
-                                ESP_LOGI(TAG, "OnReceive event %s socket %s[%d] %d: returns %d/%d bytes", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLengthAfterProcess, nLength);
-                                nLength = nLengthAfterProcess;
-                            }
-                        }
-                        
-                        int nLengthPush;
-                        int nFillStreamTCP;
-
-                        nLengthPush = drv_stream_push(pSocket->pRecvStreamBuffer[nConnectionIndex], au8Temp, nLength);
-                        nFillStreamTCP = drv_stream_get_size(pSocket->pRecvStreamBuffer[nConnectionIndex]);
-                        //nLengthPush = xStreamBufferSend(*pSocket->pRecvStreamBuffer[nConnectionIndex], au8Temp, nLength, pdMS_TO_TICKS(0));
-                        //nFillStreamTCP = xStreamBufferBytesAvailable(*pSocket->pRecvStreamBuffer[nConnectionIndex]);
-
-                        if(nLengthPush != nLength)
-                        {
-                            ESP_LOGE(TAG, "Error during read from %s socket %s[%d] %d: push |%d/%d->%d|bytes", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLengthPush, nLength, nFillStreamTCP);
-                            //socket_disconnect(pSocket);
-                            socket_disconnect_connection(pSocket, nConnectionIndex);   /* Removing Socket Client Connection */
-                        }
-                        else
-                        {
-                            
-                            ESP_LOGI(TAG, "%s socket %s[%d] %d: push |%d/%d->%d|bytes", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLengthPush, nLength, nFillStreamTCP);
-                            //ESP_LOG_BUFFER_CHAR(TAG "03", au8Temp, nLength);
-                        }
-                    }
-                    else
+                    pConnection->bRecvPaused = false;
+                    ESP_LOGI(TAG, "socket %s[%d] receive resumed (%d bytes queued)", pSocket->cName, nIndex, nSize);
+                    if (pSocket->onRecvWatermark != NULL)
                     {
-                        ESP_LOGE(TAG, "Error during read from %s socket %s[%d] %d: peek/recv %d/%d bytes", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLengthPeek, nLength);
-                        //socket_disconnect(pSocket);
-                        socket_disconnect_connection(pSocket, nConnectionIndex);   /* Removing Socket Client Connection */
+                        pSocket->onRecvWatermark(nIndex, false);
                     }
                 }
-                else
-                {
-                    err = errno;
-                    ESP_LOGE(TAG, "Error during read data from %s socket %s[%d] %d: errno %d (%s)", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, err, strerror(err));
-                    //socket_disconnect(pSocket);
-                    socket_disconnect_connection(pSocket, nConnectionIndex);   /* Removing Socket Client Connection */
-                }
-                free(au8Temp);
             }
             else
+            if (nSize >= socket_recv_watermark(pSocket, nIndex, true))
             {
-                ESP_LOGE(TAG, "Error during allocate %d bytes for read pull from %s socket %s[%d] %d", nLength, sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient);
+                socket_recv_pause(pSocket, nIndex);
             }
+            bPoll |= pConnection->bRecvPaused;
         }
-        else
+
+        if (pSocket->nSendHighWatermark > 0)
         {
-            err = errno;
-            if (err != EAGAIN)
+            int nSize = socket_send_queued_size(pSocket, nIndex);
+            if ((pConnection->bSendHigh == false) && (nSize >= pSocket->nSendHighWatermark))
             {
-                ESP_LOGE(TAG, "Error during read peek from %s socket %s[%d] %d: errno %d (%s)", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, err, strerror(err));
-                
-                char disconnected_IP [ 16 ] ;
-                inet_ntoa_r ( ( ( struct sockaddr_in * ) ( pSocket -> nSocketIndexPrimerIP + nConnectionIndex ) ) -> sin_addr . s_addr, disconnected_IP, sizeof ( disconnected_IP ) - 1 ) ;                
-                ESP_LOGW (TAG, "Lost connection to IP %s", disconnected_IP ) ;    // socket_recv: Lost connection to IP 192.168.0.4
-
-                //app_power_limit_update_arrays_and_counters_on_disconnect ( ( ( struct sockaddr_in * ) ( pSocket -> nSocketIndexPrimerIP + nConnectionIndex ) ) -> sin_addr . s_addr ) ;
-
-                //socket_disconnect(pSocket);
-                socket_disconnect_connection(pSocket, nConnectionIndex);   /* Removing Socket Client Connection */
+                pConnection->bSendHigh = true;
+                ESP_LOGW(TAG, "socket %s[%d] send queue high (%d bytes)", pSocket->cName, nIndex, nSize);
+                if (pSocket->onSendWatermark != NULL)
+                {
+                    pSocket->onSendWatermark(nIndex, true);
+                }
+            }
+            else
+            if (pConnection->bSendHigh && (nSize <= pSocket->nSendLowWatermark))
+            {
+                pConnection->bSendHigh = false;
+                ESP_LOGI(TAG, "socket %s[%d] send queue low (%d bytes)", pSocket->cName, nIndex, nSize);
+                if (pSocket->onSendWatermark != NULL)
+                {
+                    pSocket->onSendWatermark(nIndex, false);
+                }
             }
+            bPoll |= pConnection->bSendHigh;
         }
     }
-    else
+
+    if (socket_timer_expired(pSocket, DRV_SOCKET_TIMER_WATERMARK))
+    {
+        socket_timer_stop(pSocket, DRV_SOCKET_TIMER_WATERMARK);
+    }
+    if (bPoll && (socket_timer_running(pSocket, DRV_SOCKET_TIMER_WATERMARK) == false))
     {
-        ESP_LOGE(TAG, "Error during allocate %d bytes for read peek from %s socket %s[%d] %d", nLength, sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient);
+        socket_timer_start(pSocket, DRV_SOCKET_TIMER_WATERMARK, pdMS_TO_TICKS(DRV_SOCKET_WATERMARK_POLL_TIME_MS));
     }
 }
 
-void socket_send(drv_socket_t* pSocket, int nConnectionIndex)
+/* *****************************************************************************
+ * Latency - log-linear histograms of send queueing and receive delivery
+ *
+ * The streams carry no framing, so a mark samples the time of the last byte
+ * queued at that moment (stream byte count). Marks taken by the serving task
+ * on push or on stream fill poll are consumed when the byte count is pulled.
+ **************************************************************************** */
+int socket_latency_bucket(uint32_t u32Us)
 {
-    int err;
-    int nSocketClient;
-    char sockTypeString[10];
+    if (u32Us < 4) return u32Us;
 
-    nSocketClient = pSocket->nSocketIndexPrimer[nConnectionIndex];
-    if (pSocket->bServerType)
+    int nMsb = 31 - __builtin_clz(u32Us);
+    int nBucket = ((nMsb - 1) * 4) + ((u32Us >> (nMsb - 2)) & 3);
+    if (nBucket >= DRV_SOCKET_LATENCY_BUCKET_COUNT) nBucket = DRV_SOCKET_LATENCY_BUCKET_COUNT - 1;
+    return nBucket;
+}
+
+/* highest value of the bucket */
+uint32_t socket_latency_bucket_us(int nBucket)
+{
+    if (nBucket < 4) return nBucket;
+
+    int nMsb = (nBucket / 4) + 1;
+    return (((uint32_t)(4 + (nBucket % 4) + 1)) << (nMsb - 2)) - 1;
+}
+
+void socket_latency_record(drv_socket_histogram_t* pHistogram, int64_t nLatencyUs)
+{
+    uint32_t u32Us = (nLatencyUs < 0) ? 0 : ((nLatencyUs > UINT32_MAX) ? UINT32_MAX : (uint32_t)nLatencyUs);
+
+    pHistogram->au32Count[socket_latency_bucket(u32Us)]++;
+    pHistogram->u32Samples++;
+    if (pHistogram->u32MaxUs < u32Us)
     {
-        strcpy(sockTypeString, "client");
+        pHistogram->u32MaxUs = u32Us;
     }
-    else
+}
+
+/* new sample if the byte count moved since the newest mark (skipped with all marks in flight) */
+void socket_latency_mark(drv_socket_latency_marks_t* pMarks, uint32_t u32Offset, int64_t nTimeUs)
+{
+    if (pMarks->u8Count > 0)
     {
-        strcpy(sockTypeString, "");
+        drv_socket_latency_mark_t* pNewest = &pMarks->mark[(pMarks->u8Head + pMarks->u8Count - 1) % DRV_SOCKET_LATENCY_MARK_COUNT];
+        if ((int32_t)(u32Offset - pNewest->u32Offset) <= 0) return;
     }
+    if (pMarks->u8Count >= DRV_SOCKET_LATENCY_MARK_COUNT) return;
 
+    drv_socket_latency_mark_t* pMark = &pMarks->mark[(pMarks->u8Head + pMarks->u8Count) % DRV_SOCKET_LATENCY_MARK_COUNT];
+    pMark->u32Offset = u32Offset;
+    pMark->nTimeUs = nTimeUs;
+    pMarks->u8Count++;
+}
 
-    //#define MAX_TCP_SEND_SIZE CONFIG_LWIP_TCP_SND_BUF_DEFAULT
-    #define MAX_TCP_SEND_SIZE 16384
-    int nLengthMax = MAX_TCP_SEND_SIZE;
-    // if (pSocket->nSetupSocketTxBufferSize != 0)
-    // {
-    //     nLengthMax = pSocket->nSetupSocketTxBufferSize;
-    // }
+/* record the marks covered by the bytes pulled so far */
+void socket_latency_consume(drv_socket_latency_marks_t* pMarks, drv_socket_histogram_t* pHistogram, uint32_t u32Offset, int64_t nTimeUs)
+{
+    while (pMarks->u8Count > 0)
+    {
+        drv_socket_latency_mark_t* pOldest = &pMarks->mark[pMarks->u8Head];
+        if ((int32_t)(u32Offset - pOldest->u32Offset) < 0) break;
 
-    int nLength = 0;
-    uint8_t* au8Temp;
+        socket_latency_record(pHistogram, nTimeUs - pOldest->nTimeUs);
+        pMarks->u8Head = (pMarks->u8Head + 1) % DRV_SOCKET_LATENCY_MARK_COUNT;
+        pMarks->u8Count--;
+    }
+}
+
+void socket_latency_reset(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    if (pSocket->pLatency == NULL) return;
+    memset(&pSocket->pLatency[nConnectionIndex], 0, sizeof(pSocket->pLatency[nConnectionIndex]));
+}
+
+/* the send bytes pulled - called after each pull from the send lanes */
+void socket_latency_send_pulled(drv_socket_t* pSocket, int nConnectionIndex, int nLength)
+{
+    drv_socket_connection_t* pConnection = &pSocket->pRuntime->connection[nConnectionIndex];
 
+    pConnection->u32SendPulled += nLength;
+    if (pSocket->pLatency == NULL) return;
+    socket_latency_consume(&pConnection->sendMarks, &pSocket->pLatency[nConnectionIndex].send, pConnection->u32SendPulled, esp_timer_get_time());
+}
+
+/* the received bytes pushed - called after each push to the receive stream */
+void socket_latency_recv_pushed(drv_socket_t* pSocket, int nConnectionIndex, int nLength)
+{
+    drv_socket_connection_t* pConnection = &pSocket->pRuntime->connection[nConnectionIndex];
+
+    pConnection->u32RecvPushed += nLength;
+    if (pSocket->pLatency == NULL) return;
+    socket_latency_mark(&pConnection->recvMarks, pConnection->u32RecvPushed, esp_timer_get_time());
+}
+
+/* producer side (drv_socket_wakeup) - enqueue time of the send data queued since the last send mark */
+void socket_latency_enqueued(drv_socket_t* pSocket, drv_socket_runtime_t* pRuntime)
+{
+    if (pSocket->pLatency == NULL) return;
 
+    int64_t nTimeUs = esp_timer_get_time();
 
-    if (pSocket->bSendEnable)
+    for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
     {
-        nLength = drv_stream_get_size(pSocket->pSendStreamBuffer[nConnectionIndex]);
-        if (nLengthMax > nLength)
+        if ((socket_stream_open(pSocket, nIndex) == false) || (socket_send_queued_size(pSocket, nIndex) <= 0)) continue;
+
+        taskENTER_CRITICAL(&socket_runtime_lock);
+        if (pRuntime->connection[nIndex].nSendEnqueueUs == 0)
         {
-            nLengthMax = nLength;
+            pRuntime->connection[nIndex].nSendEnqueueUs = nTimeUs;
         }
+        taskEXIT_CRITICAL(&socket_runtime_lock);
+    }
+}
 
-        if (nLengthMax > 0)
-        {
-            au8Temp = malloc(nLengthMax);
+/* stream fill poll - new send data (stamped at the first drv_socket_wakeup since the last mark, else now) and application pulls of the received data */
+void socket_latency_periodic(drv_socket_t* pSocket)
+{
+    if (pSocket->pLatency == NULL) return;
 
-            if (au8Temp)
-            {
-                
-                if (pSocket->pSendStreamBuffer[nConnectionIndex] != NULL)
-                {
-                    //nLength = xStreamBufferReceive(*pSocket->pSendStreamBuffer[nConnectionIndex], au8Temp, nLengthMax, pdMS_TO_TICKS(0));
-                    nLength = drv_stream_pull(pSocket->pSendStreamBuffer[nConnectionIndex], au8Temp, nLengthMax);
-                    //ESP_LOGE(TAG, "Send to %s socket %s[%d] %d: send %d/%d", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLength, nLengthMax);
-                }
+    int64_t nTimeUs = esp_timer_get_time();
+    bool bPoll = false;
 
-                // if (pSocket->pSendStreamBuffer[nConnectionIndex] != NULL)
-                // {
-                //     ESP_LOGE(TAG, "Send to %s socket %s[%d] %d: 0000 %d/%d", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLength, nLengthMax);
-                // }
+    for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
+    {
+        if (socket_stream_open(pSocket, nIndex) == false) continue;
+        drv_socket_connection_t* pConnection = &pSocket->pRuntime->connection[nIndex];
 
-                if(pSocket->bPingUse)
-                {
-                    if(nLength <= 0)
-                    {
-                        pSocket->nPingTicks += pdMS_TO_TICKS(DRV_SOCKET_TASK_REST_TIME_MS);
-                        if(pSocket->nPingTicks > pdMS_TO_TICKS(DRV_SOCKET_PING_SEND_TIME_MS))
-                        {
-                            pSocket->nPingTicks = 0;
-
-                        
-                            pSocket->nPingCount++;
-                            sprintf((char*)au8Temp, "ping_count %d \r\n", pSocket->nPingCount);
-                            nLength = strlen((char*)au8Temp);
-                        }
-                    }
-                    else
-                    {
-                        pSocket->nPingTicks = 0;
-                    }
-                }
-                
-                if(nLength > 0)
-                {
-                    int nLengthSent;
-                    if (pSocket->pRuntime->bBroadcastRxTx)
-                    {
+        taskENTER_CRITICAL(&socket_runtime_lock);
+        int64_t nEnqueueUs = pConnection->nSendEnqueueUs;
+        pConnection->nSendEnqueueUs = 0;
+        taskEXIT_CRITICAL(&socket_runtime_lock);
 
-                        bool bUseSendToIPPort = false;
-
-                        uint32_t u32SendToIP = 0xFFFFFFFF;
-                        uint16_t u16SendToPort = 0xFFFF;
-
-                        if (pSocket->onSendTo != NULL)
-                        {
-                            pSocket->onSendTo(&u32SendToIP, &u16SendToPort);
-                            u32SendToIP = htonl(u32SendToIP);
-                            if (u16SendToPort != 0) bUseSendToIPPort = true;
-                        }
-
-                        if (bUseSendToIPPort)
-                        {
-                            struct sockaddr_in *host_addr_send_ip4 = (struct sockaddr_in *)&pSocket->pRuntime->host_addr_send;
-                            host_addr_send_ip4->sin_port = htons(u16SendToPort);
-                            host_addr_send_ip4->sin_addr.s_addr = htonl(u32SendToIP);
-                            ESP_LOGW(TAG, "host_addr_send " IPSTR ":%d", IP2STR_4(host_addr_send_ip4->sin_addr.s_addr), ntohs(host_addr_send_ip4->sin_port));
-                            ESP_LOGW(TAG, "host_addr_send 0x%08X:%d", (int)(host_addr_send_ip4->sin_addr.s_addr), ntohs(host_addr_send_ip4->sin_port));
-                        }
-
-                        socklen_t socklen = sizeof(pSocket->pRuntime->host_addr_send);
-                        nLengthSent = sendto(nSocketClient, au8Temp, nLength, 0, (struct sockaddr *)&pSocket->pRuntime->host_addr_send, socklen);
-                        
-                    }
-                    else
-                    {
-                        int send_flags = 0;
-                        //send_flags |= MSG_DONTWAIT;
-                        
-                        if (nLength >=  nLengthMax)
-                        {
-                        //    send_flags |= MSG_MORE;
-                        }
-
-                        nLengthSent =   send(nSocketClient, au8Temp, nLength, send_flags);
-                        // if (pSocket->pSendStreamBuffer[nConnectionIndex] != NULL)
-                        // {
-                        //     ESP_LOGE(TAG, "Send to %s socket %s[%d] %d: 0000 %d/%d", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLength, nLengthMax);
-                        // }
-                    }
-                    
-                    if (nLengthSent > 0)
-                    {
-                        if (nLengthSent != nLength)
-                        {
-                            ESP_LOGE(TAG, "Error during send to %s socket %s[%d] %d: send %d/%d bytes", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLengthSent, nLength);
-                            //socket_disconnect(pSocket);
-                            socket_disconnect_connection(pSocket, nConnectionIndex);   /* Removing Socket Client Connection */
-                        }
-                        else
-                        {
-                            if (pSocket->onSend != NULL)
-                            {
-                                pSocket->onSend(nConnectionIndex, (char*)au8Temp, nLengthSent);
-                            }
-                            
-                        }
-                    }
-                    else
-                    {
-                        err = errno;
-                        //if (err != EAGAIN)
-                        {
-                            ESP_LOGE(TAG, "Error during send to %s socket %s[%d] %d: errno %d (%s)", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, err, strerror(err));
-                            //socket_disconnect(pSocket);
-                            socket_disconnect_connection(pSocket, nConnectionIndex);   /* Removing Socket Client Connection */
-                        }
-                    }
-                }
-                free(au8Temp);
-            }
-            else
-            {
-                ESP_LOGE(TAG, "Error during allocate %d bytes for send from %s socket %s[%d] %d", nLengthMax, sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient);
-            }
+        int nQueued = socket_send_queued_size(pSocket, nIndex);
+        socket_latency_mark(&pConnection->sendMarks, pConnection->u32SendPulled + nQueued, (nEnqueueUs != 0) ? nEnqueueUs : nTimeUs);
 
+        if (drv_stream_get_free(pSocket->pRecvStreamBuffer[nIndex]) >= 0)
+        {
+            int nSize = drv_stream_get_size(pSocket->pRecvStreamBuffer[nIndex]);
+            socket_latency_consume(&pConnection->recvMarks, &pSocket->pLatency[nIndex].recv, pConnection->u32RecvPushed - nSize, nTimeUs);
         }
 
+        /* idle connections are sampled again on the next wakeup */
+        if ((nQueued > 0) || (pConnection->sendMarks.u8Count > 0) || (pConnection->recvMarks.u8Count > 0)) bPoll = true;
     }
-    else
+
+    if (bPoll && (socket_timer_running(pSocket, DRV_SOCKET_TIMER_LATENCY) == false))    /* not started or fired */
     {
-        if (pSocket->bIndentifyNeeded)
-        {
-            pSocket->nTimeoutSendEnable += nTaskRestTimeTicks;
-            if (pSocket->nTimeoutSendEnable >= pdMS_TO_TICKS(10000))
-            {
-                ESP_LOGE(TAG, "Send Enable and Identify disable on Timeout socket %s[%d] %d", pSocket->cName, nConnectionIndex, nSocketClient);
-                if (pSocket->bIndentifyForced)
+        socket_timer_start(pSocket, DRV_SOCKET_TIMER_LATENCY, pdMS_TO_TICKS(DRV_SOCKET_LATENCY_POLL_TIME_MS));
+    }
+}
+
+/* percentile as the highest value of its bucket (max of the samples if lower) */
+uint32_t socket_latency_percentile(const drv_socket_histogram_t* pHistogram, int nPercent)
+{
+    uint32_t u32Samples = pHistogram->u32Samples;
+    if (u32Samples == 0) return 0;
+
+    uint32_t u32Rank = (uint32_t)((((uint64_t)u32Samples * nPercent) + 99) / 100);
+    uint32_t u32Count = 0;
+    for (int nBucket = 0; nBucket < DRV_SOCKET_LATENCY_BUCKET_COUNT; nBucket++)
+    {
+        u32Count += pHistogram->au32Count[nBucket];
+        if (u32Count >= u32Rank)
+        {
+            uint32_t u32Us = socket_latency_bucket_us(nBucket);
+            return (u32Us < pHistogram->u32MaxUs) ? u32Us : pHistogram->u32MaxUs;
+        }
+    }
+    return pHistogram->u32MaxUs;
+}
+
+void socket_latency_summary(const drv_socket_histogram_t* pHistogram, drv_socket_latency_summary_t* pSummary)
+{
+    pSummary->u32Samples = pHistogram->u32Samples;
+    pSummary->u32P50Us = socket_latency_percentile(pHistogram, 50);
+    pSummary->u32P90Us = socket_latency_percentile(pHistogram, 90);
+    pSummary->u32P99Us = socket_latency_percentile(pHistogram, 99);
+    pSummary->u32MaxUs = pHistogram->u32MaxUs;
+}
+
+void socket_latency_print(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    if (pSocket->pLatency == NULL) return;
+
+    drv_socket_latency_summary_t send;
+    drv_socket_latency_summary_t recv;
+    socket_latency_summary(&pSocket->pLatency[nConnectionIndex].send, &send);
+    socket_latency_summary(&pSocket->pLatency[nConnectionIndex].recv, &recv);
+    ESP_LOGI(TAG, "  %s[%d] Latency us Send(%u):p50 %u|p90 %u|p99 %u|max %u Recv(%u):p50 %u|p90 %u|p99 %u|max %u",
+        pSocket->cName, nConnectionIndex,
+        (unsigned)send.u32Samples, (unsigned)send.u32P50Us, (unsigned)send.u32P90Us, (unsigned)send.u32P99Us, (unsigned)send.u32MaxUs,
+        (unsigned)recv.u32Samples, (unsigned)recv.u32P50Us, (unsigned)recv.u32P90Us, (unsigned)recv.u32P99Us, (unsigned)recv.u32MaxUs);
+}
+
+/* send: enqueue to pull for sending, recv: push to the receive stream to pull by the application */
+bool drv_socket_latency_get(drv_socket_t* pSocket, int nConnectionIndex, bool bRecv, drv_socket_latency_summary_t* pSummary)
+{
+    if ((pSocket == NULL) || (pSocket->pLatency == NULL) || (nConnectionIndex < 0) || (nConnectionIndex >= DRV_SOCKET_SERVER_MAX_CLIENTS)) return false;
+
+    socket_latency_summary(bRecv ? &pSocket->pLatency[nConnectionIndex].recv : &pSocket->pLatency[nConnectionIndex].send, pSummary);
+    return true;
+}
+
+uint32_t socket_frame_get_u32(const uint8_t* pData)
+{
+    return ((uint32_t)pData[0] << 24) | ((uint32_t)pData[1] << 16) | ((uint32_t)pData[2] << 8) | (uint32_t)pData[3];
+}
+
+void socket_frame_put_u32(uint8_t* pData, uint32_t u32Value)
+{
+    pData[0] = (uint8_t)(u32Value >> 24);
+    pData[1] = (uint8_t)(u32Value >> 16);
+    pData[2] = (uint8_t)(u32Value >> 8);
+    pData[3] = (uint8_t)u32Value;
+}
+
+void socket_frame_header(uint8_t* pFrame, uint8_t u8Flags, int nLength, uint32_t u32Seq)
+{
+    pFrame[0] = DRV_SOCKET_FRAME_MAGIC;
+    pFrame[1] = u8Flags;
+    pFrame[2] = (uint8_t)(nLength >> 8);
+    pFrame[3] = (uint8_t)nLength;
+    socket_frame_put_u32(pFrame + 4, u32Seq);
+}
+
+/* other open connection of a multipath client or -1 */
+int socket_multipath_other_index(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
+    {
+        if ((nIndex != nConnectionIndex) && (pSocket->nSocketIndexPrimer[nIndex] >= 0)) return nIndex;
+    }
+    return -1;
+}
+
+/* deliver the whole frames received on a connection in sequence order - returns true if any was delivered */
+bool socket_multipath_frames(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    drv_socket_connection_t* pConnection = &pRuntime->connection[nConnectionIndex];
+    StreamBufferHandle_t* pStream = pSocket->pRecvStreamBuffer[0];
+    uint8_t* pFrame = pConnection->pFrameBuffer;
+    bool bDelivered = false;
+
+    pConnection->bFrameParked = false;
+    while (pConnection->nFrameBufferLength >= DRV_SOCKET_FRAME_HEADER_SIZE)
+    {
+        int nLength = (pFrame[2] << 8) | pFrame[3];
+        uint32_t u32Seq = socket_frame_get_u32(pFrame + 4);
+
+        if ((pFrame[0] != DRV_SOCKET_FRAME_MAGIC) || (nLength > DRV_SOCKET_FRAME_PAYLOAD_MAX))
+        {
+            ESP_LOGE(TAG, "Socket %s[%d] %d multipath frame error - framing lost", pSocket->cName, nConnectionIndex, pSocket->nSocketIndexPrimer[nConnectionIndex]);
+            socket_disconnect_connection(pSocket, nConnectionIndex);
+            return bDelivered;
+        }
+        if (pConnection->nFrameBufferLength < (DRV_SOCKET_FRAME_HEADER_SIZE + nLength)) break;     /* rest of the frame not received yet */
+
+        if ((pFrame[1] & DRV_SOCKET_FRAME_FLAG_HELLO) == 0)
+        {
+            int32_t nAhead = (int32_t)(u32Seq - pRuntime->u32FrameRecvSeq);
+            if ((nAhead > 0) && (socket_multipath_other_index(pSocket, nConnectionIndex) >= 0))
+            {
+                pConnection->bFrameParked = true;       /* the frames before it come on the other connection */
+                break;
+            }
+            if (nAhead < 0)
+            {
+                pSocket->stats.u32FrameDups++;          /* delivered from the other connection */
+            }
+            else
+            {
+                if (nAhead > 0)
                 {
-                    send_identification_answer(pSocket, nConnectionIndex);    //forced send identification
+                    /* single connection left - the missing frames were lost with the closed one */
+                    ESP_LOGW(TAG, "Socket %s[%d] multipath frames %u..%u lost", pSocket->cName, nConnectionIndex, (unsigned)pRuntime->u32FrameRecvSeq, (unsigned)(u32Seq - 1));
+                    pSocket->stats.u32FrameLost += nAhead;
+                    pRuntime->u32FrameRecvSeq = u32Seq;
+                }
+                int nFree = drv_stream_get_free(pStream);
+                if ((nFree >= 0) && (nFree < nLength))
+                {
+                    socket_recv_pause(pSocket, 0);      /* frame kept until the application drains the stream */
+                    break;
+                }
+                int nLengthPush = nLength;
+                if (pSocket->onReceive != NULL)
+                {
+                    nLengthPush = pSocket->onReceive(nConnectionIndex, (char*)pFrame + DRV_SOCKET_FRAME_HEADER_SIZE, nLength);
+                }
+                if (nLengthPush > 0)
+                {
+                    nLengthPush = drv_stream_push(pStream, pFrame + DRV_SOCKET_FRAME_HEADER_SIZE, nLengthPush);
+                    socket_latency_recv_pushed(pSocket, 0, nLengthPush);
+                }
+                pRuntime->u32FrameRecvSeq++;
+                bDelivered = true;
+            }
+        }
+
+        /* frame consumed */
+        pConnection->nFrameBufferLength -= DRV_SOCKET_FRAME_HEADER_SIZE + nLength;
+        memmove(pFrame, pFrame + DRV_SOCKET_FRAME_HEADER_SIZE + nLength, pConnection->nFrameBufferLength);
+    }
+    return bDelivered;
+}
+
+/* frames of all connections delivered in order - a parked connection continues once the frames before it are delivered */
+void socket_multipath_deliver(drv_socket_t* pSocket)
+{
+    bool bProgress = true;
+
+    while (bProgress && (pSocket->pRuntime->connection[0].bRecvPaused == false))
+    {
+        bProgress = false;
+        for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
+        {
+            if ((pSocket->nSocketIndexPrimer[nIndex] < 0) || (pSocket->pRuntime->connection[nIndex].pFrameBuffer == NULL)) continue;
+            if (socket_multipath_frames(pSocket, nIndex)) bProgress = true;
+        }
+    }
+}
+
+/* multipath - read a connection into its frame buffer and deliver the whole frames to pRecvStreamBuffer[0] */
+void socket_multipath_recv(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    drv_socket_connection_t* pConnection = &pSocket->pRuntime->connection[nConnectionIndex];
+    int nSocketClient = pSocket->nSocketIndexPrimer[nConnectionIndex];
+
+    if (pConnection->pFrameBuffer == NULL)
+    {
+        /* allocated once per connection slot and kept until the socket task ends */
+        pConnection->pFrameBuffer = malloc(MAX_TCP_SEND_CHUNK_SIZE);
+        pConnection->nFrameBufferLength = 0;
+        if (pConnection->pFrameBuffer == NULL)
+        {
+            pSocket->stats.u32AllocFails++;
+            ESP_LOGE(TAG, "Error during allocate %d bytes for frames of socket %s[%d] %d", MAX_TCP_SEND_CHUNK_SIZE, pSocket->cName, nConnectionIndex, nSocketClient);
+            return;
+        }
+    }
+
+    int nLength = MAX_TCP_SEND_CHUNK_SIZE - pConnection->nFrameBufferLength;
+    if (nLength <= 0) return;       /* whole frame waiting for delivery */
+
+    nLength = recv(nSocketClient, pConnection->pFrameBuffer + pConnection->nFrameBufferLength, nLength, MSG_DONTWAIT);
+    pSocket->connectionStats[nConnectionIndex].u32RecvCalls++;
+    if (nLength > 0)
+    {
+        pSocket->connectionStats[nConnectionIndex].u64BytesIn += nLength;
+        pSocket->connectionStats[nConnectionIndex].u32PacketsIn++;
+        pConnection->nFrameBufferLength += nLength;
+        socket_multipath_deliver(pSocket);
+    }
+    else
+    {
+        int err = errno;
+        if ((nLength == 0) || ((err != EAGAIN) && (err != EWOULDBLOCK)))
+        {
+            if (nLength == 0)
+            {
+                ESP_LOGE(TAG, "Closed by peer socket %s[%d] %d", pSocket->cName, nConnectionIndex, nSocketClient);
+            }
+            else
+            {
+                ESP_LOGE(TAG, "Error during read from socket %s[%d] %d: errno %d (%s)", pSocket->cName, nConnectionIndex, nSocketClient, err, strerror(err));
+            }
+            socket_disconnect_connection(pSocket, nConnectionIndex);
+        }
+        else
+        {
+            pSocket->connectionStats[nConnectionIndex].u32RecvAgain++;
+        }
+    }
+}
+
+void socket_recv(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    int err;
+    int nSocketClient;
+    char sockTypeString[10];
+
+    if (socket_multipath_framed(pSocket))
+    {
+        socket_multipath_recv(pSocket, nConnectionIndex);
+        return;
+    }
+
+    nSocketClient = pSocket->nSocketIndexPrimer[nConnectionIndex];
+    if (pSocket->bServerType)
+    {
+        strcpy(sockTypeString, "client");
+    }
+    else
+    {
+        strcpy(sockTypeString, "");
+    }
+
+    int nLength = MAX_TCP_READ_SIZE;
+    int nLengthPushSize = 0;
+    int nLengthPushFree;
+    uint8_t* au8Temp = pSocket->pRuntime->pRecvBuffer;  /* preallocated on task start - no heap usage per read */
+
+    /* read only what fits the receive stream - the rest stays in the TCP window */
+    nLengthPushSize = drv_stream_get_size(pSocket->pRecvStreamBuffer[nConnectionIndex]);
+    nLengthPushFree = drv_stream_get_free(pSocket->pRecvStreamBuffer[nConnectionIndex]);
+    if ((nLengthPushFree >= 0) && (nLength > nLengthPushFree))
+    {
+        nLength = nLengthPushFree;
+    }
+
+    if (nLength == 0)
+    {
+        ESP_LOGW(TAG, "Pause Read from %s socket %s[%d] %d because of full read buffer (%d bytes)", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLengthPushSize);
+        socket_recv_pause(pSocket, nConnectionIndex);
+        return;
+    }
+
+    /* datagrams are not truncated - read once the next one fits, dropped if it never can */
+    bool bDatagramDrop = false;
+    if (pSocket->protocol_type != DRV_SOCKET_SOCK_STREAM)
+    {
+        int nDatagram = 0;
+        if ((ioctl(nSocketClient, FIONREAD, &nDatagram) == 0) && (nDatagram > nLength))
+        {
+            if ((nDatagram > MAX_TCP_READ_SIZE) || ((nLengthPushFree >= 0) && (nDatagram > nLengthPushSize + nLengthPushFree)))
+            {
+                bDatagramDrop = true;
+            }
+            else
+            {
+                ESP_LOGW(TAG, "Pause Read from %s socket %s[%d] %d - datagram %d bytes, free %d bytes", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nDatagram, nLength);
+                socket_recv_pause(pSocket, nConnectionIndex);
+                return;
+            }
+        }
+    }
+
+    /* single non-blocking read - no peek */
+    if (pSocket->pRuntime->bBroadcastRxTx)
+    {
+        socklen_t socklen = sizeof(pSocket->pRuntime->host_addr_recv);
+        nLength = recvfrom(nSocketClient, au8Temp, nLength, MSG_DONTWAIT, (struct sockaddr *)&pSocket->pRuntime->host_addr_recv, &socklen);
+        pSocket->connectionStats[nConnectionIndex].u32RecvCalls++;
+
+        if (nLength > 0)
+        {
+            #define IP2STR_4(u32addr) ((uint8_t*)(&u32addr))[0],((uint8_t*)(&u32addr))[1],((uint8_t*)(&u32addr))[2],((uint8_t*)(&u32addr))[3]
+            struct sockaddr_in *host_addr_recv_ip4 = (struct sockaddr_in *)&pSocket->pRuntime->host_addr_recv;
+            char* adapter_interface_address = inet_ntoa(host_addr_recv_ip4->sin_addr.s_addr);
+            ESP_LOGW(TAG, "Recv %s socket %s[%d] %d (host_addr_recv %s:%d)", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, adapter_interface_address, ntohs(host_addr_recv_ip4->sin_port));
+            //ESP_LOGW(TAG, "host_addr_recv " IPSTR ":%d", IP2STR_4(host_addr_recv_ip4->sin_addr.s_addr), ntohs(host_addr_recv_ip4->sin_port));
+            //ESP_LOGW(TAG, "host_addr_recv 0x%08X:%d", (int)(host_addr_recv_ip4->sin_addr.s_addr), ntohs(host_addr_recv_ip4->sin_port));
+
+            uint32_t u32RecvFromIP;
+            uint16_t u16RecvFromPort;
+
+            u32RecvFromIP = host_addr_recv_ip4->sin_addr.s_addr;
+            u16RecvFromPort = ntohs(host_addr_recv_ip4->sin_port);
+
+            if (pSocket->onReceiveFrom != NULL)
+            {
+                pSocket->onReceiveFrom(u32RecvFromIP, u16RecvFromPort);
+            }
+        }
+    }
+    else
+    {
+        nLength = recv(nSocketClient, au8Temp, nLength, MSG_DONTWAIT);
+        pSocket->connectionStats[nConnectionIndex].u32RecvCalls++;
+    }
+
+    if ((nLength > 0) && bDatagramDrop)
+    {
+        pSocket->connectionStats[nConnectionIndex].u32RecvDrops++;
+        ESP_LOGE(TAG, "Drop datagram from %s socket %s[%d] %d - larger than the receive stream or read buffer", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient);
+    }
+    else
+    if (nLength > 0)
+    {
+        pSocket->connectionStats[nConnectionIndex].u64BytesIn += nLength;
+        pSocket->connectionStats[nConnectionIndex].u32PacketsIn++;
+        ESP_LOGD(TAG, "01 %d bytes Read on %s socket", nLength, pSocket->cName);
+        ESP_LOG_BUFFER_CHAR_LEVEL(pSocket->cName, au8Temp, nLength, ESP_LOG_DEBUG);
+
+        if (pSocket->bIndentifyForced)
+        {
+            if(memcmp((char*)au8Temp,"man mac", strlen("man mac")) == 0)
+            {
+                socket_if_get_mac(pSocket, last_mac_addr_on_identification_request);
+                ESP_LOGI(TAG, "Last MAC On Identification Request %02X:%02X:%02X:%02X:%02X:%02X", MAC2STR(last_mac_addr_on_identification_request));
+                //drv_system_set_last_mac_identification_request(last_mac_addr_on_identification_request); To Do change to use this module instead drv_system
+            }
+        }
+
+        if (pSocket->pRuntime->connection[nConnectionIndex].bIndentifyNeeded)
+        {
+            if (socket_identification_answer(pSocket, nConnectionIndex, (char*)au8Temp, nLength))
+            {
+                pSocket->pRuntime->connection[nConnectionIndex].bIndentifyNeeded = false;
+                pSocket->pRuntime->connection[nConnectionIndex].bSendEnable = true;
+                socket_timer_stop(pSocket, DRV_SOCKET_TIMER_IDENTIFY + nConnectionIndex);
+                socket_connection_state_mirror(pSocket, nConnectionIndex);
+            }
+        }
+
+        if (pSocket->bLineEndingFixCRLFToCR)
+        {
+            /* in-place compaction: drop the second char of each CR LF / LF CR pair */
+            int nLengthFixed = 1;
+            bool bSkipCompare = false;
+            for (int i = 1; i < nLength; i++)
+            {
+                if ((bSkipCompare == false)
+                 && (((au8Temp[i-1] == '\r') && (au8Temp[i] == '\n'))
+                  || ((au8Temp[i-1] == '\n') && (au8Temp[i] == '\r'))))
+                {
+                    bSkipCompare = true;
+                    continue;
                 }
+                bSkipCompare = false;
+                au8Temp[nLengthFixed++] = au8Temp[i];
+            }
+            nLength = nLengthFixed;
+        }
+
+        if (pSocket->onReceive != NULL)
+        {
+            int nLengthAfterProcess = pSocket->onReceive(nConnectionIndex, (char*)au8Temp, nLength);
+
+            if (nLengthAfterProcess != nLength)
+            {
+                ESP_LOGI(TAG, "OnReceive event %s socket %s[%d] %d: returns %d/%d bytes", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLengthAfterProcess, nLength);
+                nLength = nLengthAfterProcess;
+            }
+        }
+        
+        int nLengthPush;
+        int nFillStreamTCP;
+
+        nLengthPush = drv_stream_push(pSocket->pRecvStreamBuffer[nConnectionIndex], au8Temp, nLength);
+        if (nLengthPush > 0)
+        {
+            socket_latency_recv_pushed(pSocket, nConnectionIndex, nLengthPush);
+        }
+        nFillStreamTCP = drv_stream_get_size(pSocket->pRecvStreamBuffer[nConnectionIndex]);
+        //nLengthPush = xStreamBufferSend(*pSocket->pRecvStreamBuffer[nConnectionIndex], au8Temp, nLength, pdMS_TO_TICKS(0));
+        //nFillStreamTCP = xStreamBufferBytesAvailable(*pSocket->pRecvStreamBuffer[nConnectionIndex]);
+
+        if(nLengthPush != nLength)
+        {
+            pSocket->connectionStats[nConnectionIndex].u32PushFail++;
+            ESP_LOGE(TAG, "Error during read from %s socket %s[%d] %d: push |%d/%d->%d|bytes", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLengthPush, nLength, nFillStreamTCP);
+            /* connection kept - not read further until the application drains the stream */
+            socket_recv_pause(pSocket, nConnectionIndex);
+        }
+        else
+        {
+            ESP_LOGI(TAG, "%s socket %s[%d] %d: push |%d/%d->%d|bytes", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLengthPush, nLength, nFillStreamTCP);
+        }
+    }
+    else
+    if ((nLength == 0) && (pSocket->protocol_type != DRV_SOCKET_SOCK_STREAM))
+    {
+        /* empty datagram - nothing to deliver */
+    }
+    else
+    {
+        err = errno;
+        if ((nLength == 0) || ((err != EAGAIN) && (err != EWOULDBLOCK)))
+        {
+            if (nLength == 0)
+            {
+                ESP_LOGE(TAG, "Closed by peer %s socket %s[%d] %d", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient);
+            }
+            else
+            {
+                ESP_LOGE(TAG, "Error during read from %s socket %s[%d] %d: errno %d (%s)", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, err, strerror(err));
+            }
+            
+            char disconnected_IP [ 16 ] ;
+            inet_ntoa_r ( ( ( struct sockaddr_in * ) ( pSocket -> nSocketIndexPrimerIP + nConnectionIndex ) ) -> sin_addr . s_addr, disconnected_IP, sizeof ( disconnected_IP ) - 1 ) ;                
+            ESP_LOGW (TAG, "Lost connection to IP %s", disconnected_IP ) ;    // socket_recv: Lost connection to IP 192.168.0.4
+
+            //app_power_limit_update_arrays_and_counters_on_disconnect ( ( ( struct sockaddr_in * ) ( pSocket -> nSocketIndexPrimerIP + nConnectionIndex ) ) -> sin_addr . s_addr ) ;
+
+            //socket_disconnect(pSocket);
+            socket_disconnect_connection(pSocket, nConnectionIndex);   /* Removing Socket Client Connection */
+        }
+        else
+        {
+            pSocket->connectionStats[nConnectionIndex].u32RecvAgain++;
+        }
+    }
+}
+
+/* coalescing - small writes held until nCoalesceSize bytes are queued or the hold time expires, then sent in one chunk */
+bool socket_send_coalesce_hold(drv_socket_t* pSocket, int nConnectionIndex, int nLane)
+{
+    drv_socket_connection_t* pConnection = &pSocket->pRuntime->connection[nConnectionIndex];
+    int nTimer = DRV_SOCKET_TIMER_COALESCE + nConnectionIndex;
+
+    if ((pSocket->nCoalesceSize <= 0) || (pSocket->protocol_type != DRV_SOCKET_SOCK_STREAM)) return false;
+    if (nLane == DRV_SOCKET_SEND_LANE_CONTROL) pConnection->bCoalesceFlush = true;
+    if (pConnection->bCoalesceFlush) return false;
+
+    if ((socket_send_queued_size(pSocket, nConnectionIndex) >= pSocket->nCoalesceSize) || socket_timer_expired(pSocket, nTimer))
+    {
+        socket_timer_stop(pSocket, nTimer);
+        pConnection->bCoalesceFlush = true;
+        return false;
+    }
+    if (socket_timer_running(pSocket, nTimer) == false)
+    {
+        int nCoalesceTimeMs = pSocket->nCoalesceTimeMs;
+        if (nCoalesceTimeMs <= 0)
+        {
+            nCoalesceTimeMs = DRV_SOCKET_COALESCE_TIME_MS;
+        }
+        TickType_t nCoalesceTicks = pdMS_TO_TICKS(nCoalesceTimeMs);
+        socket_timer_start(pSocket, nTimer, (nCoalesceTicks > 0) ? nCoalesceTicks : 1);
+    }
+    return true;
+}
+
+/* next frame of the send stream complete - its queue header is pulled first, the payload follows it (drv_socket_frame_send) */
+bool socket_multipath_frame_ready(drv_socket_t* pSocket)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    StreamBufferHandle_t* pStream = pSocket->pSendStreamBuffer[0];
+    uint8_t au8Header[DRV_SOCKET_FRAME_QUEUE_HEADER_SIZE];
+
+    if (pStream == NULL) return false;
+    if (pRuntime->nFrameSendLength < 0)
+    {
+        if (drv_stream_get_size(pStream) < DRV_SOCKET_FRAME_QUEUE_HEADER_SIZE) return false;
+        drv_stream_pull(pStream, au8Header, sizeof(au8Header));
+        socket_latency_send_pulled(pSocket, 0, sizeof(au8Header));
+        pRuntime->nFrameSendLength = (au8Header[0] << 8) | au8Header[1];
+        pRuntime->u8FrameSendFlags = au8Header[2];
+        if ((pRuntime->nFrameSendLength == 0) || (pRuntime->nFrameSendLength > DRV_SOCKET_FRAME_PAYLOAD_MAX))
+        {
+            ESP_LOGE(TAG, "Socket %s send stream is not framed (drv_socket_frame_send) - dropped", pSocket->cName);
+            drv_stream_zero(pStream);
+            pRuntime->nFrameSendLength = -1;
+            return false;
+        }
+    }
+    return drv_stream_get_size(pStream) >= pRuntime->nFrameSendLength;
+}
+
+/* duplicate mode - copy the critical frame just staged to the other connection */
+void socket_multipath_duplicate(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    int nIndex = socket_multipath_other_index(pSocket, nConnectionIndex);
+
+    if (nIndex < 0) return;
+
+    drv_socket_connection_t* pSource = &pRuntime->connection[nConnectionIndex];
+    drv_socket_connection_t* pTarget = &pRuntime->connection[nIndex];
+    if ((pTarget->bSendEnable == false) || (pTarget->pSendBuffer == NULL) || pTarget->bFrameHello
+     || (pTarget->nSendBufferOffset < pTarget->nSendBufferLength))
+    {
+        /* the frame still reaches the peer on the active connection */
+        pSocket->stats.u32FrameDupSkips++;
+        ESP_LOGW(TAG, "Socket %s[%d] multipath duplicate skipped (previous frame not sent)", pSocket->cName, nIndex);
+        return;
+    }
+    memcpy(pTarget->pSendBuffer, pSource->pSendBuffer, pSource->nSendBufferLength);
+    pTarget->nSendBufferOffset = 0;
+    pTarget->nSendBufferLength = pSource->nSendBufferLength;
+    pTarget->nStagedLane = -1;
+}
+
+/* multipath - stage the HELLO frame of the connection, or the next frame of the send stream on the active connection */
+void socket_multipath_stage(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    drv_socket_connection_t* pConnection = &pRuntime->connection[nConnectionIndex];
+
+    pConnection->nStagedLane = -1;
+    if (pConnection->bFrameHello)
+    {
+        socket_frame_header(pConnection->pSendBuffer, DRV_SOCKET_FRAME_FLAG_HELLO, sizeof(uint32_t), 0);
+        socket_frame_put_u32(pConnection->pSendBuffer + DRV_SOCKET_FRAME_HEADER_SIZE, pRuntime->u32FrameSession);
+        pConnection->nSendBufferLength = DRV_SOCKET_FRAME_HEADER_SIZE + sizeof(uint32_t);
+        pConnection->bFrameHello = false;
+        return;
+    }
+    if ((nConnectionIndex != pRuntime->nMultipathActiveIndex) || (socket_multipath_frame_ready(pSocket) == false)) return;
+
+    int nLength = pRuntime->nFrameSendLength;
+    drv_stream_pull(pSocket->pSendStreamBuffer[0], pConnection->pSendBuffer + DRV_SOCKET_FRAME_HEADER_SIZE, nLength);
+    socket_latency_send_pulled(pSocket, 0, nLength);
+    socket_frame_header(pConnection->pSendBuffer, pRuntime->u8FrameSendFlags, nLength, pRuntime->u32FrameSendSeq++);
+    pConnection->nSendBufferLength = DRV_SOCKET_FRAME_HEADER_SIZE + nLength;
+    pRuntime->nFrameSendLength = -1;
+
+    if ((pRuntime->u8FrameSendFlags & DRV_SOCKET_FRAME_FLAG_CRITICAL) && (pSocket->multipath == DRV_SOCKET_MULTIPATH_DUPLICATE))
+    {
+        socket_multipath_duplicate(pSocket, nConnectionIndex);
+    }
+}
+
+/* HELLO frame or (active connection) a whole frame in the send stream */
+bool socket_multipath_send_pending(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    if (pSocket->pRuntime->connection[nConnectionIndex].bFrameHello) return true;
+    return (nConnectionIndex == pSocket->pRuntime->nMultipathActiveIndex) && socket_multipath_frame_ready(pSocket);
+}
+
+/* multipath connection closed - its partly sent frame sent again on the other connection, the secondary promoted,
+   a frame parked on the other connection released */
+void socket_multipath_remove(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    drv_socket_connection_t* pConnection = &pRuntime->connection[nConnectionIndex];
+
+    if (socket_multipath_framed(pSocket) == false) return;
+
+    pConnection->nFrameBufferLength = 0;
+    pConnection->bFrameParked = false;
+
+    int nOtherIndex = socket_multipath_other_index(pSocket, nConnectionIndex);
+    if (nOtherIndex < 0)
+    {
+        pRuntime->nMultipathIndex = -1;
+        return;
+    }
+    drv_socket_connection_t* pOther = &pRuntime->connection[nOtherIndex];
+
+    if ((pConnection->nSendBufferOffset > 0) && (pConnection->nSendBufferOffset < pConnection->nSendBufferLength)
+     && ((pConnection->pSendBuffer[1] & DRV_SOCKET_FRAME_FLAG_HELLO) == 0))
+    {
+        /* whole frame again - the peer drops it if its copy arrived */
+        if ((pOther->pSendBuffer != NULL) && (pOther->bFrameHello == false) && (pOther->nSendBufferOffset >= pOther->nSendBufferLength))
+        {
+            memcpy(pOther->pSendBuffer, pConnection->pSendBuffer, pConnection->nSendBufferLength);
+            pOther->nSendBufferOffset = 0;
+            pOther->nSendBufferLength = pConnection->nSendBufferLength;
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Socket %s[%d] multipath frame partly sent on the closed connection is lost", pSocket->cName, nConnectionIndex);
+        }
+    }
+
+    if ((pRuntime->nMultipathIndex >= 0) && (pRuntime->nMultipathIndex != nConnectionIndex))
+    {
+        /* primary lost - the secondary connection continues as primary */
+        ESP_LOGW(TAG, "Socket %s multipath secondary %d promoted to primary", pSocket->cName, pRuntime->nMultipathIndex);
+        pRuntime->adapter_if = pRuntime->multipath_if;
+        pRuntime->adapterif_addr = pRuntime->multipath.bind_addr;
+        strcpy(pRuntime->cAdapterInterfaceIP, pRuntime->multipath.cBindIP);
+    }
+    pRuntime->nMultipathIndex = -1;
+    pRuntime->nMultipathActiveIndex = nOtherIndex;
+
+    if (pOther->bFrameParked)
+    {
+        pOther->bFrameParked = false;       /* the missing frames are skipped on its next delivery */
+    }
+}
+
+/* send up to nLengthMax bytes of the connection, returns the bytes accepted by the stack */
+int socket_send(drv_socket_t* pSocket, int nConnectionIndex, int nLengthMax)
+{
+    int err;
+    int nSocketClient;
+    char sockTypeString[10];
+
+    nSocketClient = pSocket->nSocketIndexPrimer[nConnectionIndex];
+    if (pSocket->bServerType)
+    {
+        strcpy(sockTypeString, "client");
+    }
+    else
+    {
+        strcpy(sockTypeString, "");
+    }
+
+    drv_socket_connection_t* pConnection = &pSocket->pRuntime->connection[nConnectionIndex];
+    int nLengthBudget = nLengthMax;
+    int nLength = 0;
+    uint8_t* au8Temp;
+
+    if (pConnection->bSendEnable)
+    {
+        if (pConnection->pSendBuffer == NULL)
+        {
+            /* allocated once per connection slot and kept until the socket task ends */
+            pConnection->pSendBuffer = malloc(MAX_TCP_SEND_CHUNK_SIZE);
+            pConnection->nSendBufferOffset = 0;
+            pConnection->nSendBufferLength = 0;
+            if (pConnection->pSendBuffer == NULL)
+            {
+                pSocket->stats.u32AllocFails++;
+                ESP_LOGE(TAG, "Error during allocate %d bytes for send from %s socket %s[%d] %d", MAX_TCP_SEND_CHUNK_SIZE, sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient);
+                return 0;
+            }
+        }
+
+        if(pSocket->bPingUse && (socket_multipath_framed(pSocket) == false))
+        {
+            if ((pConnection->nSendBufferOffset >= pConnection->nSendBufferLength)
+             && (socket_send_lane_select(pSocket, nConnectionIndex) < 0))
+            {
+                if (socket_timer_expired(pSocket, DRV_SOCKET_TIMER_PING + nConnectionIndex))
+                {
+                    socket_timer_stop(pSocket, DRV_SOCKET_TIMER_PING + nConnectionIndex);
+
+                    pConnection->nPingCount++;
+                    socket_connection_state_mirror(pSocket, nConnectionIndex);
+                    sprintf((char*)pConnection->pSendBuffer, "ping_count %u \r\n", (unsigned)pConnection->nPingCount);
+                    pConnection->nSendBufferOffset = 0;
+                    pConnection->nSendBufferLength = strlen((char*)pConnection->pSendBuffer);
+                    pConnection->nStagedLane = -1;
+                }
+                else
+                if (socket_timer_running(pSocket, DRV_SOCKET_TIMER_PING + nConnectionIndex) == false)
+                {
+                    socket_timer_start(pSocket, DRV_SOCKET_TIMER_PING + nConnectionIndex, pdMS_TO_TICKS(DRV_SOCKET_PING_SEND_TIME_MS));
+                }
+            }
+            else
+            {
+                socket_timer_stop(pSocket, DRV_SOCKET_TIMER_PING + nConnectionIndex);
+            }
+        }
+
+        while (nLengthBudget > 0)
+        {
+            /* refill the staging buffer only after everything staged is accepted by the stack */
+            if (pConnection->nSendBufferOffset >= pConnection->nSendBufferLength)
+            {
+                pConnection->nSendBufferOffset = 0;
+                pConnection->nSendBufferLength = 0;
+                /* lanes selected again on each refill - control data waits at most for the staged chunk */
+                int nLane = -1;
+                if (socket_multipath_framed(pSocket))
+                {
+                    socket_multipath_stage(pSocket, nConnectionIndex);     /* whole frames - lanes and coalescing not used */
+                }
+                else
+                {
+                    nLane = socket_send_lane_select(pSocket, nConnectionIndex);
+                }
+                if (nLane < 0)
+                {
+                    pConnection->bCoalesceFlush = false;    /* drained - next data coalesced again */
+                    socket_timer_stop(pSocket, DRV_SOCKET_TIMER_COALESCE + nConnectionIndex);
+                }
+                else
+                if (socket_send_coalesce_hold(pSocket, nConnectionIndex, nLane) == false)
+                {
+                    int nLengthPull = MAX_TCP_SEND_CHUNK_SIZE;
+                    if (nLengthPull > nLengthBudget)
+                    {
+                        nLengthPull = nLengthBudget;
+                    }
+                    if ((nLane == DRV_SOCKET_SEND_LANE_BULK) && (nLengthPull > DRV_SOCKET_SEND_BULK_CHUNK_SIZE))
+                    {
+                        nLengthPull = DRV_SOCKET_SEND_BULK_CHUNK_SIZE;
+                    }
+                    //nLength = xStreamBufferReceive(*pSocket->pSendStreamBuffer[nConnectionIndex], au8Temp, nLengthMax, pdMS_TO_TICKS(0));
+                    nLength = drv_stream_pull(socket_send_lane_stream(pSocket, nLane, nConnectionIndex), pConnection->pSendBuffer, nLengthPull);
+                    if (nLength > 0)
+                    {
+                        socket_latency_send_pulled(pSocket, nConnectionIndex, nLength);
+                        pConnection->au32LanePulled[nLane] += nLength;
+                        pConnection->nStagedLane = nLane;
+                        pConnection->nSendBufferLength = nLength;
+                    }
+                }
+            }
+
+            nLength = pConnection->nSendBufferLength - pConnection->nSendBufferOffset;
+            if (nLength <= 0)
+            {
+                break;
+            }
+            au8Temp = pConnection->pSendBuffer + pConnection->nSendBufferOffset;
+
+            int nLengthSent;
+            if (pSocket->pRuntime->bBroadcastRxTx)
+            {
+
+                bool bUseSendToIPPort = false;
+
+                uint32_t u32SendToIP = 0xFFFFFFFF;
+                uint16_t u16SendToPort = 0xFFFF;
+
+                if (pSocket->onSendTo != NULL)
+                {
+                    pSocket->onSendTo(&u32SendToIP, &u16SendToPort);
+                    u32SendToIP = htonl(u32SendToIP);
+                    if (u16SendToPort != 0) bUseSendToIPPort = true;
+                }
+
+                if (bUseSendToIPPort)
+                {
+                    struct sockaddr_in *host_addr_send_ip4 = (struct sockaddr_in *)&pSocket->pRuntime->host_addr_send;
+                    host_addr_send_ip4->sin_port = htons(u16SendToPort);
+                    host_addr_send_ip4->sin_addr.s_addr = htonl(u32SendToIP);
+                    ESP_LOGW(TAG, "host_addr_send " IPSTR ":%d", IP2STR_4(host_addr_send_ip4->sin_addr.s_addr), ntohs(host_addr_send_ip4->sin_port));
+                    ESP_LOGW(TAG, "host_addr_send 0x%08X:%d", (int)(host_addr_send_ip4->sin_addr.s_addr), ntohs(host_addr_send_ip4->sin_port));
+                }
+
+                socklen_t socklen = sizeof(pSocket->pRuntime->host_addr_send);
+                nLengthSent = sendto(nSocketClient, au8Temp, nLength, 0, (struct sockaddr *)&pSocket->pRuntime->host_addr_send, socklen);
+                pSocket->connectionStats[nConnectionIndex].u32SendCalls++;
+                
+            }
+            else
+            {
+                nLengthSent = send(nSocketClient, au8Temp, nLength, 0);
+                pSocket->connectionStats[nConnectionIndex].u32SendCalls++;
+            }
+            
+            if (nLengthSent > 0)
+            {
+                pSocket->connectionStats[nConnectionIndex].u64BytesOut += nLengthSent;
+                pSocket->connectionStats[nConnectionIndex].u32PacketsOut++;
+                /* consume only the bytes accepted by the stack - the rest stays staged */
+                pConnection->nSendBufferOffset += nLengthSent;
+                nLengthBudget -= nLengthSent;
+                if (pConnection->u8AckMarkCount > 0)
+                {
+                    socket_ack_sent(pSocket, nConnectionIndex);
+                }
+
+                if (pSocket->onSend != NULL)
+                {
+                    pSocket->onSend(nConnectionIndex, (char*)au8Temp, nLengthSent);
+                }
+
+                if (nLengthSent != nLength)
+                {
+                    /* tail retried on the next writability of the socket */
+                    pSocket->connectionStats[nConnectionIndex].u32SendShort++;
+                    ESP_LOGD(TAG, "Partial send to %s socket %s[%d] %d: send %d/%d bytes", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLengthSent, nLength);
+                    break;
+                }
+            }
+            else
+            {
+                err = errno;
+                if ((nLengthSent < 0) && ((err == EAGAIN) || (err == EWOULDBLOCK)))
+                {
+                    /* non-blocking socket send buffer full - keep the staged data */
+                    pSocket->connectionStats[nConnectionIndex].u32SendAgain++;
+                    ESP_LOGD(TAG, "Send to %s socket %s[%d] %d would block - %d bytes pending", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, nLength);
+                }
+                else
+                {
+                    ESP_LOGE(TAG, "Error during send to %s socket %s[%d] %d: errno %d (%s)", sockTypeString, pSocket->cName, nConnectionIndex, nSocketClient, err, strerror(err));
+                    //socket_disconnect(pSocket);
+                    socket_disconnect_connection(pSocket, nConnectionIndex);   /* Removing Socket Client Connection */
+                }
+                break;
+            }
+        }
+    }
+    else
+    {
+        if (pConnection->bIndentifyNeeded)
+        {
+            if (socket_timer_expired(pSocket, DRV_SOCKET_TIMER_IDENTIFY + nConnectionIndex))
+            {
+                socket_timer_stop(pSocket, DRV_SOCKET_TIMER_IDENTIFY + nConnectionIndex);
+                ESP_LOGE(TAG, "Send Enable and Identify disable on Timeout socket %s[%d] %d", pSocket->cName, nConnectionIndex, nSocketClient);
+                if (pSocket->bIndentifyForced)
+                {
+                    send_identification_answer(pSocket, nConnectionIndex);    //forced send identification
+                }
+
+                pConnection->bSendEnable = true;
+                pConnection->bIndentifyNeeded = false;
+                socket_connection_state_mirror(pSocket, nConnectionIndex);
+            }
+        }
+        else
+        {
+            pConnection->bSendEnable = true;
+            socket_connection_state_mirror(pSocket, nConnectionIndex);
+        }
+    }
+    return nLengthMax - nLengthBudget;
+}
+
+/* data staged or waiting in the send stream of the connection */
+bool socket_send_pending(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    drv_socket_connection_t* pConnection = &pSocket->pRuntime->connection[nConnectionIndex];
+
+    if (pConnection->bSendEnable == false) return false;
+    if (pSocket->pRuntime->nFailoverSocket >= 0) return false;      /* held until the old connection is drained */
+    if (pConnection->nSendBufferOffset < pConnection->nSendBufferLength) return true;
+    if (socket_multipath_framed(pSocket)) return socket_multipath_send_pending(pSocket, nConnectionIndex);
+    if ((pConnection->bCoalesceFlush == false) && socket_timer_running(pSocket, DRV_SOCKET_TIMER_COALESCE + nConnectionIndex)) return false;    /* held until the deadline */
+    return socket_send_lane_select(pSocket, nConnectionIndex) >= 0;
+}
+
+/* deficit round robin over the connections - each connection with pending data gets quantum * weight bytes per round,
+   the first connection served rotates on each pass */
+void socket_send_schedule(drv_socket_t* pSocket)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    bool abDone[DRV_SOCKET_SERVER_MAX_CLIENTS] = {0};
+    int nStart = pRuntime->nSendNext;
+
+    for (int nRound = 0; nRound < DRV_SOCKET_SEND_ROUNDS; nRound++)
+    {
+        bool bProgress = false;
+
+        for (int nOrder = 0; nOrder < DRV_SOCKET_SERVER_MAX_CLIENTS; nOrder++)
+        {
+            int nIndex = (nStart + nOrder) % DRV_SOCKET_SERVER_MAX_CLIENTS;
+            drv_socket_connection_t* pConnection = &pRuntime->connection[nIndex];
+
+            if (abDone[nIndex] || (pSocket->nSocketIndexPrimer[nIndex] < 0)) continue;
+            if ((nRound == 0) && (socket_event_writable(pSocket, nIndex) == false))
+            {
+                abDone[nIndex] = true;
+                continue;
+            }
+
+            int nQuantum = DRV_SOCKET_SEND_QUANTUM * pConnection->u8SendWeight;
+            pConnection->nSendDeficit += nQuantum;
+            int nLengthSent = socket_send(pSocket, nIndex, pConnection->nSendDeficit);
+            pConnection->nSendDeficit -= nLengthSent;
+            if (nLengthSent > 0) bProgress = true;
+
+            if (pSocket->nSocketIndexPrimer[nIndex] < 0)
+            {
+                abDone[nIndex] = true;      /* closed on send error */
+            }
+            else
+            if (pConnection->nSendBufferOffset < pConnection->nSendBufferLength)
+            {
+                /* stack full - no burst credit while blocked */
+                abDone[nIndex] = true;
+                if (pConnection->nSendDeficit > nQuantum) pConnection->nSendDeficit = nQuantum;
+            }
+            else
+            if (socket_send_pending(pSocket, nIndex) == false)
+            {
+                /* no backlog - no credit kept */
+                abDone[nIndex] = true;
+                pConnection->nSendDeficit = 0;
+            }
+        }
+        if (bProgress == false) break;
+    }
+    pRuntime->nSendNext = (nStart + 1) % DRV_SOCKET_SERVER_MAX_CLIENTS;
+}
+
+/* IP Address of an adapter interface (INADDR_ANY if default, INADDR_NONE if bad) */
+in_addr_t socket_get_interface_address(esp_interface_t adapter_if)
+{
+    esp_netif_ip_info_t ip_info;
+    struct sockaddr_in adapter_interface_addr;
+
+    adapter_interface_addr.sin_addr.s_addr = htonl(INADDR_NONE);
+
+    if(adapter_if == ESP_IF_WIFI_STA)
+    {
+        #if CONFIG_DRV_WIFI_USE
+        esp_netif_t* esp_netif = drv_wifi_get_netif_sta();
+        if (esp_netif != NULL)
+        {
+            esp_netif_get_ip_info(esp_netif, &ip_info);
+            inet_addr_from_ip4addr(&adapter_interface_addr.sin_addr,&ip_info.ip);
+        }
+        #else
+        adapter_interface_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        #endif
+    }
+    else 
+    if(adapter_if == ESP_IF_WIFI_AP)
+    {
+        #if CONFIG_DRV_WIFI_USE
+        esp_netif_t* esp_netif = drv_wifi_get_netif_ap();
+        if (esp_netif != NULL)
+        {
+            esp_netif_get_ip_info(esp_netif, &ip_info);
+            inet_addr_from_ip4addr(&adapter_interface_addr.sin_addr,&ip_info.ip);
+        }
+        #else
+        adapter_interface_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        #endif
+    }
+    else //if(pSocket->adapter_if >= ESP_IF_ETH)
+    {
+        #if CONFIG_DRV_ETH_USE
+        int eth_index = adapter_if - ESP_IF_ETH;
+        if (drv_eth_get_netif_count() > eth_index)
+        {
+            esp_netif_t* esp_netif = drv_eth_get_netif(eth_index);
+            if (esp_netif != NULL)
+            {
+                esp_netif_get_ip_info(esp_netif, &ip_info);
+                inet_addr_from_ip4addr(&adapter_interface_addr.sin_addr,&ip_info.ip);
+            }
+        }
+        else    /* use default */
+        #endif
+        {
+            adapter_interface_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        }
+    }
+    return adapter_interface_addr.sin_addr.s_addr;
+}
+
+void socket_get_adapter_interface_ip(drv_socket_t* pSocket)
+{
+    /* Get IP Address of the selected adapter interface (new selected ip address stored as string in pSocket->pRuntime->cAdapterInterfaceIP) */
+    in_addr_t interface_address = socket_get_interface_address(pSocket->pRuntime->adapter_if);
+    char *adapter_interface_ip = ip4addr_ntoa_r((ip4_addr_t*)&interface_address, pSocket->pRuntime->cAdapterInterfaceIP, sizeof(pSocket->pRuntime->cAdapterInterfaceIP));
+    
+    if (interface_address == htonl(INADDR_NONE))
+    {
+        ESP_LOGE(TAG, "Socket %s bad or unimplemented adapter interface selected: %d", pSocket->cName, pSocket->pRuntime->adapter_if);
+    }
+    else if (interface_address == htonl(INADDR_ANY))
+    {
+        ESP_LOGW(TAG, "Socket %s default adapter interface selected IP: %s", pSocket->cName, adapter_interface_ip);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Socket %s adapter interface selected IP: %s", pSocket->cName, adapter_interface_ip);
+    }
+
+    //pSocket->pRuntime->adapter_interface_ip_address = interface_address;
+}
+
+void socket_prepare_adapter_interface_ip_info(drv_socket_t* pSocket)
+{
+    /* Configure Bind to IP Info (Adapter interface Info) */
+    #ifdef CONFIG_EXAMPLE_IPV6
+    // Note that by default IPV6 binds to both protocols, it is must be disabled
+    // if both protocols used at the same time (used in CI)
+    if (pSocket->bIPV6)setsockopt(pSocket->nSocketIndex, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof(opt));
+    #endif
+
+    #ifdef CONFIG_EXAMPLE_IPV6
+    if (pSocket->bIPV6)
+    {
+        struct sockaddr_in6 *dest_addr_ip6 = (struct sockaddr_in6 *)&pSocket->pRuntime->adapterif_addr;
+        bzero(&dest_addr_ip6->sin6_addr.un, sizeof(dest_addr_ip6->sin6_addr.un));
+        dest_addr_ip6->sin6_family = pSocket->address_family;
+        dest_addr_ip6->sin6_port = htons(pSocket->u16Port);
+    }
+    else
+    #endif
+    {
+        struct sockaddr_in *dest_addr_ip4 = (struct sockaddr_in *)&pSocket->pRuntime->adapterif_addr;
+        //dest_addr_ip4->sin_addr.s_addr = pSocket->pRuntime->adapter_interface_ip_address;
+        dest_addr_ip4->sin_addr.s_addr = inet_addr(pSocket->pRuntime->cAdapterInterfaceIP);
+        dest_addr_ip4->sin_family = pSocket->address_family;
+        dest_addr_ip4->sin_port = htons(pSocket->u16Port);
+    }
+}
+
+
+
+void clear_dns_cache() 
+{
+    esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    if (netif == NULL) {
+        printf("Failed to get netif handle\n");
+        return;
+    }
+    esp_netif_dns_info_t dns_info = {0};
+    dns_info.ip.u_addr.ip4.addr = 0;
+    esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns_info);
+    esp_netif_set_dns_info(netif, ESP_NETIF_DNS_BACKUP, &dns_info);
+}
+
+#if CONFIG_DRV_DNS_USE
+/* background resolver shared by all sockets - one drv_dns_resolve() at a time */
+static void socket_dns_resolver_task(void* parameters)
+{
+    (void)parameters;
+    int nEntryIndex;
+    char cURL[sizeof(socket_dns_cache[0].cURL)];
+    char cIP[sizeof(socket_dns_cache[0].cIP)];
+
+    while (1)
+    {
+        if (xQueueReceive(socket_dns_queue, &nEntryIndex, portMAX_DELAY) != pdTRUE) continue;
+
+        drv_socket_dns_entry_t* pEntry = &socket_dns_cache[nEntryIndex];
+        taskENTER_CRITICAL(&socket_dns_lock);
+        strcpy(cURL, pEntry->cURL);
+        taskEXIT_CRITICAL(&socket_dns_lock);
+
+        ESP_LOGI(TAG, "DNS start resolve URL %s", cURL);
+        bool bResolved = drv_dns_resolve(cURL, cIP, sizeof(cIP), &bSocketDnsActive);
+        if (bResolved)
+        {
+            ESP_LOGI(TAG, "DNS resolved URL %s to ip address: %s", cURL, cIP);
+        }
+        else
+        {
+            ESP_LOGE(TAG, "DNS fail resolve URL %s", cURL);
+        }
+
+        taskENTER_CRITICAL(&socket_dns_lock);
+        if (strcmp(pEntry->cURL, cURL) == 0)
+        {
+            if (bResolved)
+            {
+                strcpy(pEntry->cIP, cIP);
+                pEntry->bValid = true;
+                pEntry->nExpireTick = xTaskGetTickCount() + pdMS_TO_TICKS(DRV_SOCKET_DNS_CACHE_TTL_MS);
+            }
+            else
+            {
+                pEntry->nExpireTick = xTaskGetTickCount() + pdMS_TO_TICKS(DRV_SOCKET_DNS_RETRY_TIME_MS);    /* keep the stale ip if any */
+            }
+        }
+        pEntry->bResolving = false;
+        taskEXIT_CRITICAL(&socket_dns_lock);
+
+        /* sockets waiting for the url continue */
+        socket_list_wakeup(cURL);
+    }
+}
+
+bool socket_dns_resolver_start(void)
+{
+    if (socket_dns_task != NULL) return true;
+
+    socket_dns_queue = xQueueCreate(DRV_SOCKET_DNS_CACHE_SIZE, sizeof(int));
+    if (socket_dns_queue == NULL)
+    {
+        ESP_LOGE(TAG, "Unable to create DNS resolver queue");
+        return false;
+    }
+    xTaskCreate(socket_dns_resolver_task, "socket_dns", DRV_SOCKET_DNS_TASK_STACK_SIZE, NULL, uxTaskPriorityGet(NULL), &socket_dns_task);
+    if (socket_dns_task == NULL)
+    {
+        ESP_LOGE(TAG, "Unable to create DNS resolver task");
+        return false;
+    }
+    return true;
+}
+
+/* cached ip of the url (stale entries served while refreshed) - queues a background resolve if missing or expired.
+ * returns true if pIP is valid, *pbPending set while the resolve is in progress */
+bool socket_dns_cache_get(const char* pURL, char* pIP, size_t nSize, bool* pbPending)
+{
+    TickType_t nTickNow = xTaskGetTickCount();
+    drv_socket_dns_entry_t* pEntry = NULL;
+    int nEntryIndex = -1;
+    bool bValid = false;
+    bool bRequest = false;
+
+    taskENTER_CRITICAL(&socket_dns_lock);
+    for (int nIndex = 0; nIndex < DRV_SOCKET_DNS_CACHE_SIZE; nIndex++)
+    {
+        if (strcmp(socket_dns_cache[nIndex].cURL, pURL) == 0)
+        {
+            nEntryIndex = nIndex;
+            break;
+        }
+    }
+    if (nEntryIndex < 0)
+    {
+        /* free or least recently used entry (not while being resolved) */
+        for (int nIndex = 0; nIndex < DRV_SOCKET_DNS_CACHE_SIZE; nIndex++)
+        {
+            if (socket_dns_cache[nIndex].bResolving) continue;
+            if ((nEntryIndex < 0) || (socket_dns_cache[nIndex].cURL[0] == 0)
+             || ((int32_t)(socket_dns_cache[nIndex].nUseTick - socket_dns_cache[nEntryIndex].nUseTick) < 0))
+            {
+                nEntryIndex = nIndex;
+                if (socket_dns_cache[nIndex].cURL[0] == 0) break;
+            }
+        }
+        if (nEntryIndex >= 0)
+        {
+            pEntry = &socket_dns_cache[nEntryIndex];
+            snprintf(pEntry->cURL, sizeof(pEntry->cURL), "%s", pURL);
+            pEntry->bValid = false;
+            pEntry->nExpireTick = nTickNow;
+        }
+    }
+    if (nEntryIndex >= 0)
+    {
+        pEntry = &socket_dns_cache[nEntryIndex];
+        pEntry->nUseTick = nTickNow;
+        bValid = pEntry->bValid;
+        if (bValid && (pIP != NULL))
+        {
+            snprintf(pIP, nSize, "%s", pEntry->cIP);
+        }
+        if ((pEntry->bResolving == false) && ((int32_t)(nTickNow - pEntry->nExpireTick) >= 0))
+        {
+            pEntry->bResolving = true;
+            bRequest = true;
+        }
+    }
+    taskEXIT_CRITICAL(&socket_dns_lock);
+
+    if (bRequest)
+    {
+        if ((socket_dns_resolver_start() == false) || (xQueueSend(socket_dns_queue, &nEntryIndex, 0) != pdTRUE))
+        {
+            taskENTER_CRITICAL(&socket_dns_lock);
+            pEntry->bResolving = false;
+            taskEXIT_CRITICAL(&socket_dns_lock);
+        }
+    }
+
+    if (pbPending != NULL)
+    {
+        *pbPending = (pEntry != NULL) && pEntry->bResolving;
+    }
+    return bValid;
+}
+#endif
+
+/* *****************************************************************************
+ * Persisted last good endpoint (NVS, file on linux target)
+ **************************************************************************** */
+bool socket_persist_read(const char* pKey, drv_socket_last_good_t* pRecord)
+{
+    #if CONFIG_IDF_TARGET_LINUX
+    char cPath[32];
+    snprintf(cPath, sizeof(cPath), DRV_SOCKET_PERSIST_FILE_FORMAT, pKey);
+    FILE* pFile = fopen(cPath, "rb");
+    if (pFile == NULL) return false;
+    bool bResult = (fread(pRecord, sizeof(*pRecord), 1, pFile) == 1);
+    fclose(pFile);
+    return bResult;
+    #else
+    nvs_handle_t hNvs;
+    size_t nSize = sizeof(*pRecord);
+    if (nvs_open(DRV_SOCKET_PERSIST_NAMESPACE, NVS_READONLY, &hNvs) != ESP_OK) return false;
+    esp_err_t err = nvs_get_blob(hNvs, pKey, pRecord, &nSize);
+    nvs_close(hNvs);
+    return (err == ESP_OK) && (nSize == sizeof(*pRecord));
+    #endif
+}
+
+bool socket_persist_write(const char* pKey, const drv_socket_last_good_t* pRecord)
+{
+    #if CONFIG_IDF_TARGET_LINUX
+    char cPath[32];
+    snprintf(cPath, sizeof(cPath), DRV_SOCKET_PERSIST_FILE_FORMAT, pKey);
+    FILE* pFile = fopen(cPath, "wb");
+    if (pFile == NULL) return false;
+    bool bResult = (fwrite(pRecord, sizeof(*pRecord), 1, pFile) == 1);
+    fclose(pFile);
+    return bResult;
+    #else
+    nvs_handle_t hNvs;
+    if (nvs_open(DRV_SOCKET_PERSIST_NAMESPACE, NVS_READWRITE, &hNvs) != ESP_OK) return false;
+    esp_err_t err = nvs_set_blob(hNvs, pKey, pRecord, sizeof(*pRecord));
+    if (err == ESP_OK) err = nvs_commit(hNvs);
+    nvs_close(hNvs);
+    return (err == ESP_OK);
+    #endif
+}
+
+/* host the address of a connection belongs to - endpoint or cURL */
+const char* socket_last_good_host(drv_socket_t* pSocket, int nEndpointIndex)
+{
+    if (nEndpointIndex >= 0) return pSocket->endpoint[nEndpointIndex].cHost;
+    return pSocket->cURL;
+}
+
+/* load the last successful connect - used only if host and port are still configured */
+void socket_last_good_load(drv_socket_t* pSocket)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    drv_socket_last_good_t* pRecord = &pRuntime->lastGood;
+    char cKey[16];
+
+    pRuntime->bLastGoodValid = false;
+    pRuntime->bLastGoodAttempt = false;
+    if ((pSocket->bPersistEndpoint == false) || pSocket->bServerType) return;
+
+    snprintf(cKey, sizeof(cKey), DRV_SOCKET_PERSIST_KEY_FORMAT, pSocket->cName);
+    if (socket_persist_read(cKey, pRecord) == false)
+    {
+        ESP_LOGI(TAG, "Socket %s no last good endpoint stored", pSocket->cName);
+        return;
+    }
+    pRecord->cHost[sizeof(pRecord->cHost) - 1] = 0;
+    pRecord->cIP[sizeof(pRecord->cIP) - 1] = 0;
+
+    if ((pRecord->u8Version != DRV_SOCKET_PERSIST_VERSION)
+     || (pRecord->u8InterfaceIndex > DRV_SOCKET_ADAPTER_INTERFACE_BACKUP)
+     || (pRecord->nEndpointIndex >= pSocket->nEndpointCount)
+     || ((pRecord->nEndpointIndex < 0) && (pSocket->nEndpointCount > 0))
+     || (strcmp(pRecord->cHost, socket_last_good_host(pSocket, pRecord->nEndpointIndex)) != 0))
+    {
+        ESP_LOGW(TAG, "Socket %s last good endpoint %s does not match the configuration", pSocket->cName, pRecord->cHost);
+        return;
+    }
+    uint16_t u16Port = pSocket->u16Port;
+    if ((pRecord->nEndpointIndex >= 0) && (pSocket->endpoint[pRecord->nEndpointIndex].u16Port != 0))
+    {
+        u16Port = pSocket->endpoint[pRecord->nEndpointIndex].u16Port;
+    }
+    if (pRecord->u16Port != u16Port)
+    {
+        ESP_LOGW(TAG, "Socket %s last good endpoint %s port %d does not match the configuration", pSocket->cName, pRecord->cHost, pRecord->u16Port);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Socket %s last good endpoint %s (%s:%d)", pSocket->cName, pRecord->cHost, pRecord->cIP, pRecord->u16Port);
+    pRuntime->bLastGoodValid = true;
+    if (pRecord->nEndpointIndex >= 0)
+    {
+        pRuntime->nEndpointWinner = pRecord->nEndpointIndex;
+    }
+}
+
+/* store the connected address - written only on change */
+void socket_last_good_save(drv_socket_t* pSocket)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    struct sockaddr_in* pAddr = (struct sockaddr_in*)&pRuntime->host_addr_main;
+    drv_socket_last_good_t record = {0};
+    char cKey[16];
+
+    pRuntime->bLastGoodAttempt = false;
+    if ((pSocket->bPersistEndpoint == false) || pSocket->bServerType) return;
+    if (pAddr->sin_family != AF_INET) return;
+
+    record.u8Version = DRV_SOCKET_PERSIST_VERSION;
+    record.u8InterfaceIndex = (pRuntime->adapter_if == pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_BACKUP]) ? DRV_SOCKET_ADAPTER_INTERFACE_BACKUP : DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT;
+    record.nEndpointIndex = pRuntime->nEndpointIndex;
+    record.u16Port = ntohs(pAddr->sin_port);
+    snprintf(record.cHost, sizeof(record.cHost), "%s", socket_last_good_host(pSocket, pRuntime->nEndpointIndex));
+    inet_ntoa_r(pAddr->sin_addr.s_addr, record.cIP, sizeof(record.cIP) - 1);
+
+    if (pRuntime->bLastGoodValid && (memcmp(&record, &pRuntime->lastGood, sizeof(record)) == 0)) return;
+
+    pRuntime->lastGood = record;
+    pRuntime->bLastGoodValid = true;
+    snprintf(cKey, sizeof(cKey), DRV_SOCKET_PERSIST_KEY_FORMAT, pSocket->cName);
+    if (socket_persist_write(cKey, &record))
+    {
+        ESP_LOGI(TAG, "Socket %s stored last good endpoint %s (%s:%d)", pSocket->cName, record.cHost, record.cIP, record.u16Port);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Socket %s store last good endpoint Failure", pSocket->cName);
+    }
+}
+
+/* client connect waits for the first background resolve of cURL (up to the dns wait time) */
+bool socket_dns_host_ready(drv_socket_t* pSocket)
+{
+    #if CONFIG_DRV_DNS_USE
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    bool bPending = false;
+
+    if (pRuntime->bLastGoodValid)
+    {
+        pRuntime->bDnsWait = false;
+        socket_timer_stop(pSocket, DRV_SOCKET_TIMER_DNS_WAIT);
+        return true;        /* last good address used until resolved */
+    }
+
+    if (pSocket->nEndpointCount > 0)
+    {
+        /* all endpoint URLs resolved or failed */
+        for (int nIndex = 0; nIndex < pSocket->nEndpointCount; nIndex++)
+        {
+            struct in_addr addr;
+            bool bPendingEndpoint;
+            if (inet_aton(pSocket->endpoint[nIndex].cHost, &addr)) continue;
+            if (socket_dns_cache_get(pSocket->endpoint[nIndex].cHost, NULL, 0, &bPendingEndpoint) == false)
+            {
+                bPending |= bPendingEndpoint;
+            }
+        }
+    }
+    else
+    {
+        if ((strlen(pSocket->cURL) == 0) || pRuntime->bHostIPFallback) return true;
+
+        if (socket_dns_cache_get(pSocket->cURL, NULL, 0, &bPending)) bPending = false;
+    }
+
+    if (bPending == false)
+    {
+        pRuntime->bDnsWait = false;
+        socket_timer_stop(pSocket, DRV_SOCKET_TIMER_DNS_WAIT);
+        return true;        /* resolved or resolve failed (default ip used) */
+    }
+    if (pRuntime->bDnsWait == false)
+    {
+        ESP_LOGI(TAG, "Socket %s wait resolve URL", pSocket->cName);
+        pRuntime->bDnsWait = true;
+        socket_timer_start(pSocket, DRV_SOCKET_TIMER_DNS_WAIT, pdMS_TO_TICKS(DRV_SOCKET_DNS_WAIT_TIME_MS));
+        return false;
+    }
+    if (socket_timer_expired(pSocket, DRV_SOCKET_TIMER_DNS_WAIT))
+    {
+        socket_timer_stop(pSocket, DRV_SOCKET_TIMER_DNS_WAIT);
+        ESP_LOGE(TAG, "Socket %s resolve URL timeout", pSocket->cName);
+        pRuntime->bDnsWait = false;
+        return true;
+    }
+    return false;
+    #else
+    (void)pSocket;
+    return true;
+    #endif
+}
+
+/* address of an endpoint - IPv4 address or cached resolve of the URL, false if not (yet) resolved */
+bool socket_endpoint_get_ip(drv_socket_t* pSocket, int nEndpointIndex, char* pIP, size_t nSize)
+{
+    const char* pHost = pSocket->endpoint[nEndpointIndex].cHost;
+    struct in_addr addr;
+
+    if (inet_aton(pHost, &addr))
+    {
+        snprintf(pIP, nSize, "%s", pHost);
+        return true;
+    }
+    #if CONFIG_DRV_DNS_USE
+    if (socket_dns_cache_get(pHost, pIP, nSize, NULL)) return true;
+    if (pSocket->pRuntime->bLastGoodValid && (pSocket->pRuntime->lastGood.nEndpointIndex == nEndpointIndex))
+    {
+        snprintf(pIP, nSize, "%s", pSocket->pRuntime->lastGood.cIP);
+        return true;
+    }
+    return false;
+    #else
+    return false;
+    #endif
+}
+
+/* try resolve cURL to IP Address. If not resolved - use cHostIP (endpoint address if connecting to an endpoint) */
+char* socket_get_host_ip_address(drv_socket_t* pSocket)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+
+    pRuntime->bLastGoodAttempt = false;
+    if ((pRuntime->nEndpointIndex >= 0) && (pRuntime->nEndpointIndex < pSocket->nEndpointCount))
+    {
+        if (socket_endpoint_get_ip(pSocket, pRuntime->nEndpointIndex, pRuntime->cEndpointIP, sizeof(pRuntime->cEndpointIP)))
+        {
+            if (pSocket->endpoint[pRuntime->nEndpointIndex].u16Port != 0)
+            {
+                pRuntime->u16HostPort = pSocket->endpoint[pRuntime->nEndpointIndex].u16Port;
+            }
+            return pRuntime->cEndpointIP;
+        }
+        ESP_LOGE(TAG, "Socket %s endpoint %s not resolved - use default IP: %s", pSocket->cName, pSocket->endpoint[pRuntime->nEndpointIndex].cHost, pSocket->cHostIP);
+    }
+
+    #if CONFIG_DRV_DNS_USE
+    if ((strlen(pSocket->cURL) > 0) && (pSocket->pRuntime->bHostIPFallback == false))
+    {
+        if (socket_dns_cache_get(pSocket->cURL, pSocket->cHostIPResolved, sizeof(pSocket->cHostIPResolved), NULL))
+        {
+            ESP_LOGI(TAG, "Socket %s resolved URL %s to ip address: %s", pSocket->cName, pSocket->cURL, pSocket->cHostIPResolved);
+            return pSocket->cHostIPResolved;
+        }
+        if (pRuntime->bLastGoodValid && (pRuntime->lastGood.nEndpointIndex < 0))
+        {
+            ESP_LOGI(TAG, "Socket %s URL %s not resolved yet - use last good IP: %s", pSocket->cName, pSocket->cURL, pRuntime->lastGood.cIP);
+            pRuntime->bLastGoodAttempt = true;
+            strcpy(pSocket->cHostIPResolved, pRuntime->lastGood.cIP);
+            return pSocket->cHostIPResolved;
+        }
+        ESP_LOGE(TAG, "Socket %s URL %s not resolved - use default IP: %s", pSocket->cName, pSocket->cURL, pSocket->cHostIP);
+    }
+    #endif
+    return pSocket->cHostIP;
+}
+
+void socket_prepare_host_ip_info(drv_socket_t* pSocket)
+{
+    char cRecvFromIP[16] = "255.255.255.255";
+    char* pRecvFromIP = cRecvFromIP;
+
+    //char cSendToIP[16] = "192.168.3.118";
+    char cSendToIP[16] = "255.255.255.255";
+    char* pSendToIP = cSendToIP;
+
+
+    /* Host IP Address Preparation - host_addr_main */
+    pSocket->pRuntime->bBroadcastRxTx = false;
+    #ifdef CONFIG_EXAMPLE_IPV6
+    if (pSocket->bIPV6)
+    {
+        struct sockaddr_in6 *host_addr_ip6 = (struct sockaddr_in6 *)&pSocket->pRuntime->host_addr_main;
+        host_addr_ip6->sin6_addr.un = inet_addr(pSocket->pRuntime->pLastUsedHostIP);
+        host_addr_ip6->sin6_family = pSocket->address_family;
+        host_addr_ip6->sin6_port = htons(pSocket->pRuntime->u16HostPort);
+
+        struct sockaddr_in6 *host_addr_recv_ip6 = (struct sockaddr_in6 *)&pSocket->pRuntime->host_addr_recv;
+        host_addr_recv_ip6->sin6_addr.un = inet_addr(pRecvFromIP);
+        host_addr_recv_ip6->sin6_family = pSocket->address_family;
+        host_addr_recv_ip6->sin6_port = htons(pSocket->u16Port);
+
+        struct sockaddr_in6 *host_addr_send_ip6 = (struct sockaddr_in6 *)&pSocket->pRuntime->host_addr_send;
+        host_addr_send_ip6->sin6_addr.un = inet_addr(pSendToIP);
+        host_addr_send_ip6->sin6_family = pSocket->address_family;
+        host_addr_send_ip6->sin6_port = htons(pSocket->u16Port);
+    }
+    else
+    #endif
+    {
+        struct sockaddr_in *host_addr_ip4 = (struct sockaddr_in *)&pSocket->pRuntime->host_addr_main;
+        host_addr_ip4->sin_addr.s_addr = inet_addr(pSocket->pRuntime->pLastUsedHostIP);
+        host_addr_ip4->sin_family = pSocket->address_family;
+        host_addr_ip4->sin_port = htons(pSocket->pRuntime->u16HostPort);
+
+        struct sockaddr_in *host_addr_recv_ip4 = (struct sockaddr_in *)&pSocket->pRuntime->host_addr_recv;
+        host_addr_recv_ip4->sin_addr.s_addr = inet_addr(pRecvFromIP);
+        host_addr_recv_ip4->sin_family = pSocket->address_family;
+        host_addr_recv_ip4->sin_port = htons(pSocket->u16Port);
+
+        struct sockaddr_in *host_addr_send_ip4 = (struct sockaddr_in *)&pSocket->pRuntime->host_addr_send;
+        host_addr_send_ip4->sin_addr.s_addr = inet_addr(pSendToIP);
+        host_addr_send_ip4->sin_family = pSocket->address_family;
+        host_addr_send_ip4->sin_port = htons(pSocket->u16Port);
+
+        if (((host_addr_ip4->sin_addr.s_addr >> 0) & 0xFF) == 0xFF)pSocket->pRuntime->bBroadcastRxTx = true;
+        if (((host_addr_ip4->sin_addr.s_addr >> 8) & 0xFF) == 0xFF)pSocket->pRuntime->bBroadcastRxTx = true;
+        if (((host_addr_ip4->sin_addr.s_addr >>16) & 0xFF) == 0xFF)pSocket->pRuntime->bBroadcastRxTx = true;
+        if (((host_addr_ip4->sin_addr.s_addr >>24) & 0xFF) == 0xFF)pSocket->pRuntime->bBroadcastRxTx = true;
+    }
+
+    ESP_LOGI(TAG, "Socket %s Bind/Connect: %s", pSocket->cName, pSocket->pRuntime->pLastUsedHostIP); 
+    ESP_LOGI(TAG, "Socket %s RecvFrom:     %s", pSocket->cName, pRecvFromIP); 
+    ESP_LOGI(TAG, "Socket %s SendTo:       %s", pSocket->cName, pSendToIP); 
+
+
+}
+
+void socket_strt(drv_socket_t* pSocket)
+{
+    int err;
+    int nSocketIndex = socket(pSocket->address_family, pSocket->protocol_type, pSocket->protocol);
+
+    if (nSocketIndex < 0) 
+    {
+        err = errno;
+        ESP_LOGE(TAG, "Unable to create socket %s %d: errno %d (%s)", pSocket->cName, nSocketIndex, err, strerror(err));
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Created socket %s %d: AdapterIF: %d Address Family: %d", pSocket->cName, nSocketIndex, pSocket->pRuntime->adapter_if, pSocket->address_family);
+    }
+    if (pSocket->bServerType)
+    {
+        pSocket->nSocketIndexServer = nSocketIndex;
+    }
+    else
+    {
+        /* added to the connection list when connected */
+        pSocket->pRuntime->connect.nSocket = nSocketIndex;
+        //pSocket->nSocketIndexPrimer = nSocketIndex;
+    }
+}
+
+/* accept all pending connections of the (non-blocking) listening socket */
+void socket_connect_server_periodic(drv_socket_t* pSocket)
+{
+    int err;
+
+    ESP_LOGD(TAG, "Socket %s %d periodic check incoming connections", pSocket->cName, pSocket->nSocketIndexServer);
+
+    while (pSocket->nSocketIndexServer >= 0)
+    {
+        struct sockaddr_storage source_addr; // Large enough for both IPv4 or IPv6
+        socklen_t addr_len = sizeof(source_addr);
+
+        int nNewSocketClientIndex = accept(pSocket->nSocketIndexServer, (struct sockaddr *)&source_addr, &addr_len);
+        if (nNewSocketClientIndex < 0) 
+        {
+            err = errno;
+            if ((err != EAGAIN) && (err != EWOULDBLOCK))
+            {
+                ESP_LOGE(TAG, "Socket %s %d Unable to accept connection %d: errno %d (%s)", pSocket->cName, pSocket->nSocketIndexServer, nNewSocketClientIndex, err, strerror(err));
+                //socket_disconnect(pSocket); //To Do check not to disconnect socket if no more connections available
+            }
+            break;      /* no more pending connections */
+        }
+
+        char addr_str[128] = "";
+        if (source_addr.ss_family == PF_INET) 
+        {
+            inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr, addr_str, sizeof(addr_str) - 1);
+        }
+        else if (source_addr.ss_family == PF_INET6) 
+        {
+            #if LWIP_IPV6
+            inet6_ntoa_r(((struct sockaddr_in6 *)&source_addr)->sin6_addr, addr_str, sizeof(addr_str) - 1);
+            #else
+            ESP_LOGE(TAG, "Socket %s %d IPv6 Need LWIP_IPV6 defined", pSocket->cName, pSocket->nSocketIndexServer);
+            #endif
+        }
+        ESP_LOGI(TAG, "Socket %s %d accepted ip address: %s", pSocket->cName, pSocket->nSocketIndexServer, addr_str);
+
+        /* accepted clients do not inherit the listener mode - apply bNonBlockingMode */
+        int flags = fcntl(nNewSocketClientIndex, F_GETFL, 0);
+        if (pSocket->bNonBlockingMode)
+        {
+            fcntl(nNewSocketClientIndex, F_SETFL, flags | O_NONBLOCK);
+        }
+        else
+        {
+            fcntl(nNewSocketClientIndex, F_SETFL, flags & ~O_NONBLOCK);
+        }
+
+        int nConnectionIndex = socket_connection_add_to_list(pSocket, nNewSocketClientIndex);
+        if (nConnectionIndex >= 0)
+        {
+            pSocket->nSocketIndexPrimerIP[nConnectionIndex] = source_addr;
+        }
+        else
+        {
+            close(nNewSocketClientIndex);   /* no free slot - reject instead of keeping it queued */
+        }
+    }
+}
+
+void socket_connect_server(drv_socket_t* pSocket)
+{
+    int err = 0;
+
+    int opt = 1;
+    socklen_t optlen = sizeof(opt);
 
-                pSocket->bSendEnable = true;
-                pSocket->bIndentifyNeeded = false;
-            }
+    int ret_so;
+
+    ret_so = getsockopt( pSocket->nSocketIndexServer , SOL_SOCKET, SO_REUSEADDR,(void*)&opt, &optlen);
+    if (ret_so < 0)
+    {
+        err = errno;
+        ESP_LOGE(TAG, LOG_COLOR(LOG_COLOR_CYAN)"Socket %s %d getsockopt  SO_REUSEADDR=%d retv = %d. errno %d (%s)", pSocket->cName, pSocket->nSocketIndexServer, opt, ret_so, err, strerror(errno));
+    }
+
+    opt = 1;
+    ret_so = setsockopt( pSocket->nSocketIndexServer , SOL_SOCKET, SO_REUSEADDR,(void*)&opt, sizeof(opt));
+    if (ret_so < 0)
+    {
+        err = errno;
+        ESP_LOGE(TAG, LOG_COLOR(LOG_COLOR_CYAN)"Socket %s %d setsockopt  SO_REUSEADDR=%d retv = %d. errno %d (%s)", pSocket->cName, pSocket->nSocketIndexServer, opt, ret_so, err, strerror(errno));
+    }
+
+    //vTaskDelay(pdMS_TO_TICKS(100));
+
+
+
+    int eError = bind(pSocket->nSocketIndexServer, (struct sockaddr *)&pSocket->pRuntime->adapterif_addr, sizeof(pSocket->pRuntime->adapterif_addr));
+    if (eError != 0) 
+    {
+        err = errno;
+        ESP_LOGE(TAG, "Socket %s %d unable to bind: errno %d (%s)", pSocket->cName, pSocket->nSocketIndexServer, err, strerror(err));
+
+        struct sockaddr_in *test_addr_ip4 = (struct sockaddr_in *)&pSocket->pRuntime->adapterif_addr;
+        //dest_addr_ip4->sin_addr.s_addr = pSocket->pRuntime->adapter_interface_ip_address;
+
+        in_addr_t interfaceAddress = test_addr_ip4->sin_addr.s_addr;
+        const ip4_addr_t* pInterfaceAddress = (const ip4_addr_t*)&interfaceAddress;
+        char cAdapterInterfaceIP[16];
+        char *adapter_interface_ip = ip4addr_ntoa_r(pInterfaceAddress, cAdapterInterfaceIP, sizeof(cAdapterInterfaceIP));
+        ESP_LOGW(TAG, "Socket %s %d adapterif addr:%s port:%d family:%d", pSocket->cName, pSocket->nSocketIndexServer, adapter_interface_ip, htons(test_addr_ip4->sin_port), test_addr_ip4->sin_family);
+        
+        socket_disconnect(pSocket);
+        //close(pSocket->nSocketIndexServer);
+        //pSocket->nSocketIndexServer = -1;
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Socket %s %d bound to IF %s:%d", pSocket->cName, pSocket->nSocketIndexServer, pSocket->pRuntime->cAdapterInterfaceIP, pSocket->u16Port);
+
+        int nListenBacklog = pSocket->nListenBacklog;
+        if (nListenBacklog <= 0)
+        {
+            nListenBacklog = CONFIG_DRV_SOCKET_SERVER_LISTEN_BACKLOG;
+        }
+
+        eError = listen(pSocket->nSocketIndexServer, nListenBacklog);
+        if (eError != 0) 
+        {
+            err = errno;
+            ESP_LOGE(TAG, "Error occurred during listen socket %s %d: errno %d (%s)", pSocket->cName, pSocket->nSocketIndexServer, err, strerror(err));
+            socket_disconnect(pSocket);
+            //close(pSocket->nSocketIndexServer);
+            //pSocket->nSocketIndexServer = -1;
         }
         else
         {
-            pSocket->bSendEnable = true;
+            ESP_LOGI(TAG, "Socket %s %d listening (backlog %d)", pSocket->cName, pSocket->nSocketIndexServer, nListenBacklog);
+
+            /* Set the listening socket to non-blocking mode once - accept never blocks the task */
+            int flags = fcntl(pSocket->nSocketIndexServer, F_GETFL, 0);
+            fcntl(pSocket->nSocketIndexServer, F_SETFL, flags | O_NONBLOCK);
+
+            socket_connect_server_periodic(pSocket);
         }
     }
 }
 
-void socket_get_adapter_interface_ip(drv_socket_t* pSocket)
+bool socket_race_attempt(drv_socket_t* pSocket, drv_socket_connect_t* pConnect)
 {
-    /* Get IP Address of the selected adapter interface (new selected ip address stored as string in pSocket->pRuntime->cAdapterInterfaceIP) */
-    esp_netif_ip_info_t ip_info;
-    struct sockaddr_in adapter_interface_addr;
+    return (pConnect >= &pSocket->pRuntime->race[0]) && (pConnect < &pSocket->pRuntime->race[DRV_SOCKET_CONNECT_RACE_COUNT]);
+}
 
-    adapter_interface_addr.sin_addr.s_addr = htonl(INADDR_NONE);
+void socket_race_stop(drv_socket_t* pSocket)
+{
+    for (int nIndex = 0; nIndex < DRV_SOCKET_CONNECT_RACE_COUNT; nIndex++)
+    {
+        socket_connect_attempt_close(pSocket, &pSocket->pRuntime->race[nIndex]);
+    }
+    socket_timer_stop(pSocket, DRV_SOCKET_TIMER_RACE_STAGGER);
+    pSocket->pRuntime->bRacing = false;
+}
 
-    if(pSocket->pRuntime->adapter_if == ESP_IF_WIFI_STA)
+/* connection index of the client connection or -1 */
+int socket_client_connection_index(drv_socket_t* pSocket)
+{
+    for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
     {
-        #if CONFIG_DRV_WIFI_USE
-        esp_netif_t* esp_netif = drv_wifi_get_netif_sta();
-        if (esp_netif != NULL)
+        if ((pSocket->nSocketIndexPrimer[nIndex] >= 0) && (nIndex != pSocket->pRuntime->nMultipathIndex)) return nIndex;
+    }
+    return -1;
+}
+
+/* runs in the tcpip thread (or under the core lock) - the pcb is not changed or freed meanwhile */
+static err_t socket_tcp_info_call(struct tcpip_api_call_data* call)
+{
+    drv_socket_tcp_info_call_t* pCall = (drv_socket_tcp_info_call_t*)call;
+    drv_socket_tcp_info_t* pInfo = pCall->pInfo;
+
+    pCall->bResult = false;
+    struct lwip_sock* sock = lwip_socket_dbg_get_socket(pCall->nSocket);
+    if ((sock != NULL) && (sock->conn != NULL) && (sock->conn->pcb.tcp != NULL))
+    {
+        struct tcp_pcb* pcb = sock->conn->pcb.tcp;
+        pInfo->nState = pcb->state;
+        pInfo->nRttMs = (pcb->sa > 0) ? ((pcb->sa >> 3) * TCP_SLOW_INTERVAL) : -1;     /* sa holds 8 * srtt in slow timer ticks */
+        pInfo->nRttVarMs = (pcb->sv >> 2) * TCP_SLOW_INTERVAL;                        /* sv holds 4 * rttvar */
+        pInfo->nRtoMs = pcb->rto * TCP_SLOW_INTERVAL;
+        pInfo->u32Cwnd = pcb->cwnd;
+        pInfo->u32Ssthresh = pcb->ssthresh;
+        pInfo->u32SendWindow = pcb->snd_wnd;
+        pInfo->u32SendBufferFree = pcb->snd_buf;
+        pInfo->u32SendQueueLength = pcb->snd_queuelen;
+        pInfo->u32UnsentBytes = pcb->snd_lbb - pcb->snd_nxt;
+        pInfo->u32UnackedBytes = pcb->snd_nxt - pcb->lastack;
+        pInfo->u32SendSeq = pcb->snd_lbb;
+        pInfo->u32AckedSeq = pcb->lastack;
+        pInfo->u16Mss = pcb->mss;
+        pInfo->u8Retransmits = pcb->nrtx;
+        pInfo->u8DupAcks = pcb->dupacks;
+        pCall->bResult = true;
+    }
+    return ERR_OK;
+}
+
+/* snapshot of the lwIP pcb of a tcp socket - false if the socket has no pcb */
+bool socket_tcp_info(int nSocket, drv_socket_tcp_info_t* pInfo)
+{
+    drv_socket_tcp_info_call_t call = {
+        .nSocket = nSocket,
+        .pInfo = pInfo,
+        .bResult = false,
+    };
+
+    if (tcpip_api_call(socket_tcp_info_call, &call.call) != ERR_OK) return false;
+    return call.bResult;
+}
+
+bool drv_socket_tcp_info_get(drv_socket_t* pSocket, int nConnectionIndex, drv_socket_tcp_info_t* pInfo)
+{
+    if ((pSocket == NULL) || (pSocket->protocol_type != DRV_SOCKET_SOCK_STREAM)) return false;
+    if ((nConnectionIndex < 0) || (nConnectionIndex >= DRV_SOCKET_SERVER_MAX_CLIENTS)) return false;
+
+    int nSocket = pSocket->nSocketIndexPrimer[nConnectionIndex];
+    if (nSocket < 0) return false;
+    return socket_tcp_info(nSocket, pInfo);
+}
+
+/* pSocket NULL - all sockets in list */
+void drv_socket_tcp_info(drv_socket_t* pSocket)
+{
+    drv_socket_t* apSocket[DRV_SOCKET_COUNT_MAX];
+    drv_socket_runtime_t* apRuntime[DRV_SOCKET_COUNT_MAX];
+    int nCount = socket_list_pin(pSocket, apSocket, apRuntime);
+
+    for (int index = 0; index < nCount; index++)
+    {
+        drv_socket_t* pSocketItem = apSocket[index];
+
+        for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
         {
-            esp_netif_get_ip_info(esp_netif, &ip_info);
-            inet_addr_from_ip4addr(&adapter_interface_addr.sin_addr,&ip_info.ip);
+            drv_socket_tcp_info_t info;
+            if (drv_socket_tcp_info_get(pSocketItem, nIndex, &info) == false) continue;
+
+            ESP_LOGI(TAG, "%s[%d] State:%d Rtt:%d(var %d) ms Rto:%d ms Cwnd:%u Ssthresh:%u Wnd:%u Mss:%u SndBuf:%u Queue:%u Unsent:%u Unacked:%u Rtx:%u DupAck:%u",
+                pSocketItem->cName, nIndex, info.nState, info.nRttMs, info.nRttVarMs, info.nRtoMs,
+                (unsigned)info.u32Cwnd, (unsigned)info.u32Ssthresh, (unsigned)info.u32SendWindow, (unsigned)info.u16Mss,
+                (unsigned)info.u32SendBufferFree, (unsigned)info.u32SendQueueLength, (unsigned)info.u32UnsentBytes, (unsigned)info.u32UnackedBytes,
+                (unsigned)info.u8Retransmits, (unsigned)info.u8DupAcks);
         }
-        #else
-        adapter_interface_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-        #endif
+        socket_runtime_put(apRuntime[index]);
     }
-    else 
-    if(pSocket->pRuntime->adapter_if == ESP_IF_WIFI_AP)
+}
+
+/* *****************************************************************************
+ * Send acknowledgement markers
+ *
+ * A marker covers the bytes queued in its lane when the serving task takes
+ * the request. It is passed to the stack once its lane byte count is pulled
+ * and not staged any more - then it waits for the peer to ack the tcp_pcb
+ * sequence number buffered at that time (snd_lbb, counts every send() of
+ * the connection - identification answers and pings included).
+ **************************************************************************** */
+void socket_ack_complete(drv_socket_t* pSocket, int nConnectionIndex, int nMark, bool bAcked)
+{
+    drv_socket_connection_t* pConnection = &pSocket->pRuntime->connection[nConnectionIndex];
+    uint32_t u32Marker = pConnection->ackMarks[nMark].u32Marker;
+
+    pConnection->ackMarks[nMark] = pConnection->ackMarks[--pConnection->u8AckMarkCount];
+    if (pSocket->onSendAcked != NULL)
     {
-        #if CONFIG_DRV_WIFI_USE
-        esp_netif_t* esp_netif = drv_wifi_get_netif_ap();
-        if (esp_netif != NULL)
+        pSocket->onSendAcked(DRV_SOCKET_CONNECTION_ID(pConnection->u16Generation, nConnectionIndex), u32Marker, bAcked);
+    }
+}
+
+/* markers of the closed connection never complete */
+void socket_ack_fail(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    while (pSocket->pRuntime->connection[nConnectionIndex].u8AckMarkCount > 0)
+    {
+        socket_ack_complete(pSocket, nConnectionIndex, 0, false);
+    }
+}
+
+/* markers with all bytes passed to the stack get their sequence number target */
+void socket_ack_sent(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    drv_socket_connection_t* pConnection = &pSocket->pRuntime->connection[nConnectionIndex];
+    bool bStaged = pConnection->nSendBufferOffset < pConnection->nSendBufferLength;
+    drv_socket_tcp_info_t info;
+    bool bInfo = false;
+
+    for (int nMark = 0; nMark < pConnection->u8AckMarkCount; nMark++)
+    {
+        drv_socket_ack_mark_t* pMark = &pConnection->ackMarks[nMark];
+        if (pMark->nLane >= DRV_SOCKET_SEND_LANE_COUNT) continue;
+        if ((int32_t)(pConnection->au32LanePulled[pMark->nLane] - pMark->u32Offset) < 0) continue;
+        if (bStaged && (pConnection->nStagedLane == pMark->nLane)) continue;
+
+        if (bInfo == false)
         {
-            esp_netif_get_ip_info(esp_netif, &ip_info);
-            inet_addr_from_ip4addr(&adapter_interface_addr.sin_addr,&ip_info.ip);
+            if (socket_tcp_info(pSocket->nSocketIndexPrimer[nConnectionIndex], &info) == false) return;    /* failed on close */
+            bInfo = true;
         }
-        #else
-        adapter_interface_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-        #endif
+        pMark->nLane = DRV_SOCKET_SEND_LANE_COUNT;
+        pMark->u32Offset = info.u32SendSeq;
     }
-    else //if(pSocket->adapter_if >= ESP_IF_ETH)
+}
+
+/* take the producer requests and complete the markers acked by the peer */
+void socket_ack_periodic(drv_socket_t* pSocket)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    drv_socket_ack_request_t request;
+    bool bPoll = false;
+
+    if (pRuntime->pAckQueue == NULL) return;
+
+    while (xQueueReceive(pRuntime->pAckQueue, &request, 0) == pdTRUE)
     {
-        #if CONFIG_DRV_ETH_USE
-        int eth_index = pSocket->pRuntime->adapter_if - ESP_IF_ETH;
-        if (drv_eth_get_netif_count() > eth_index)
+        int nConnectionIndex = drv_socket_get_connection_index(pSocket, request.nConnectionId);
+        drv_socket_connection_t* pConnection = (nConnectionIndex >= 0) ? &pRuntime->connection[nConnectionIndex] : NULL;
+
+        if ((pConnection == NULL) || (pConnection->u8AckMarkCount >= DRV_SOCKET_ACK_MARK_COUNT))
         {
-            esp_netif_t* esp_netif = drv_eth_get_netif(eth_index);
-            if (esp_netif != NULL)
-            {
-                esp_netif_get_ip_info(esp_netif, &ip_info);
-                inet_addr_from_ip4addr(&adapter_interface_addr.sin_addr,&ip_info.ip);
-            }
+            ESP_LOGW(TAG, "Socket %s send marker %u dropped", pSocket->cName, (unsigned)request.u32Marker);
+            pSocket->onSendAcked(request.nConnectionId, request.u32Marker, false);
+            continue;
         }
-        else    /* use default */
-        #endif
+
+        drv_socket_ack_mark_t* pMark = &pConnection->ackMarks[pConnection->u8AckMarkCount++];
+        pMark->u32Marker = request.u32Marker;
+        pMark->nLane = request.nLane;
+        pMark->u32Offset = pConnection->au32LanePulled[request.nLane] + drv_stream_get_size(socket_send_lane_stream(pSocket, request.nLane, nConnectionIndex));
+        socket_ack_sent(pSocket, nConnectionIndex);
+    }
+
+    for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
+    {
+        drv_socket_connection_t* pConnection = &pRuntime->connection[nIndex];
+        drv_socket_tcp_info_t info;
+
+        if ((pSocket->nSocketIndexPrimer[nIndex] < 0) || (pConnection->u8AckMarkCount == 0)) continue;
+        bPoll = true;
+        if (socket_tcp_info(pSocket->nSocketIndexPrimer[nIndex], &info) == false) continue;
+
+        for (int nMark = pConnection->u8AckMarkCount - 1; nMark >= 0; nMark--)
         {
-            adapter_interface_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+            drv_socket_ack_mark_t* pMark = &pConnection->ackMarks[nMark];
+            if ((pMark->nLane == DRV_SOCKET_SEND_LANE_COUNT) && ((int32_t)(info.u32AckedSeq - pMark->u32Offset) >= 0))
+            {
+                socket_ack_complete(pSocket, nIndex, nMark, true);
+            }
         }
     }
 
-    in_addr_t interface_address = adapter_interface_addr.sin_addr.s_addr;
-    char *adapter_interface_ip = ip4addr_ntoa_r((ip4_addr_t*)&adapter_interface_addr.sin_addr.s_addr, pSocket->pRuntime->cAdapterInterfaceIP, sizeof(pSocket->pRuntime->cAdapterInterfaceIP));
-    
-    if (interface_address == htonl(INADDR_NONE))
+    if (bPoll && (socket_timer_running(pSocket, DRV_SOCKET_TIMER_ACK) == false))    /* not started or fired */
     {
-        ESP_LOGE(TAG, "Socket %s bad or unimplemented adapter interface selected: %d", pSocket->cName, pSocket->pRuntime->adapter_if);
+        socket_timer_start(pSocket, DRV_SOCKET_TIMER_ACK, pdMS_TO_TICKS(DRV_SOCKET_ACK_POLL_TIME_MS));
     }
-    else if (interface_address == htonl(INADDR_ANY))
+}
+
+/* onSendAcked(nConnectionId, u32Marker) once the peer acked the data pushed to the lane so far */
+bool drv_socket_send_mark(drv_socket_t* pSocket, drv_socket_connection_id_t nConnectionId, drv_socket_send_lane_t lane, uint32_t u32Marker)
+{
+    bool bResult = false;
+
+    if ((lane < 0) || (lane >= DRV_SOCKET_SEND_LANE_COUNT)) return false;
+    if (socket_multipath_framed(pSocket)) return false;     /* frames may leave on the other connection */
+
+    /* runtime kept first - the connection id is resolved against the generation of this runtime */
+    drv_socket_runtime_t* pRuntime = socket_runtime_get(pSocket);
+    if (pRuntime == NULL) return false;
+
+    int nConnectionIndex = drv_socket_get_connection_index(pSocket, nConnectionId);
+    if ((nConnectionIndex >= 0) && (socket_send_lane_stream(pSocket, lane, nConnectionIndex) != NULL) && (pRuntime->pAckQueue != NULL))
     {
-        ESP_LOGW(TAG, "Socket %s default adapter interface selected IP: %s", pSocket->cName, adapter_interface_ip);
+        drv_socket_ack_request_t request = {
+            .nConnectionId = nConnectionId,
+            .u32Marker = u32Marker,
+            .nLane = lane,
+        };
+        bResult = (xQueueSend(pRuntime->pAckQueue, &request, 0) == pdTRUE);
     }
-    else
+    socket_runtime_put(pRuntime);
+    return bResult;
+}
+
+/* bytes not acked by the peer yet: send lanes + staged + tcp unsent and unacked (-1 if not open) */
+int drv_socket_get_bytes_in_flight(drv_socket_t* pSocket, drv_socket_connection_id_t nConnectionId)
+{
+    drv_socket_tcp_info_t info;
+
+    /* runtime kept while read - the staged length is a snapshot of the serving task state */
+    drv_socket_runtime_t* pRuntime = socket_runtime_get(pSocket);
+    if (pRuntime == NULL) return -1;
+
+    int nConnectionIndex = drv_socket_get_connection_index(pSocket, nConnectionId);
+    if (nConnectionIndex < 0)
     {
-        ESP_LOGI(TAG, "Socket %s adapter interface selected IP: %s", pSocket->cName, adapter_interface_ip);
+        socket_runtime_put(pRuntime);
+        return -1;
     }
 
-    //pSocket->pRuntime->adapter_interface_ip_address = interface_address;
+    drv_socket_connection_t* pConnection = &pRuntime->connection[nConnectionIndex];
+    int nStaged = pConnection->nSendBufferLength - pConnection->nSendBufferOffset;
+    int nBytes = socket_send_queued_size(pSocket, socket_stream_index(pSocket, nConnectionIndex));
+    if (nStaged > 0)
+    {
+        nBytes += nStaged;
+    }
+    if (drv_socket_tcp_info_get(pSocket, nConnectionIndex, &info))
+    {
+        nBytes += info.u32UnsentBytes + info.u32UnackedBytes;
+    }
+    socket_runtime_put(pRuntime);
+    return nBytes;
 }
 
-void socket_prepare_adapter_interface_ip_info(drv_socket_t* pSocket)
+/* replace the client connection by the failover connection - staged tail kept only if the old connection is drained */
+void socket_failover_switch(drv_socket_t* pSocket, int nConnectionIndex, bool bDrained)
 {
-    /* Configure Bind to IP Info (Adapter interface Info) */
-    #ifdef CONFIG_EXAMPLE_IPV6
-    // Note that by default IPV6 binds to both protocols, it is must be disabled
-    // if both protocols used at the same time (used in CI)
-    if (pSocket->bIPV6)setsockopt(pSocket->nSocketIndex, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof(opt));
-    #endif
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    int nSocket = pRuntime->nFailoverSocket;
+    int nSocketOld = pSocket->nSocketIndexPrimer[nConnectionIndex];
+    drv_socket_connection_t* pConnection = &pRuntime->connection[nConnectionIndex];
 
-    #ifdef CONFIG_EXAMPLE_IPV6
-    if (pSocket->bIPV6)
+    pRuntime->nFailoverSocket = -1;
+    socket_timer_stop(pSocket, DRV_SOCKET_TIMER_FAILOVER_DRAIN);
+    socket_timer_stop(pSocket, DRV_SOCKET_TIMER_FAILOVER_POLL);
+
+    if (bDrained)
     {
-        struct sockaddr_in6 *dest_addr_ip6 = (struct sockaddr_in6 *)&pSocket->pRuntime->adapterif_addr;
-        bzero(&dest_addr_ip6->sin6_addr.un, sizeof(dest_addr_ip6->sin6_addr.un));
-        dest_addr_ip6->sin6_family = pSocket->address_family;
-        dest_addr_ip6->sin6_port = htons(pSocket->u16Port);
+        ESP_LOGW(TAG, "Socket %s failover %d -> %d (%d bytes unsent migrated)", pSocket->cName, nSocketOld, nSocket, pConnection->nSendBufferLength - pConnection->nSendBufferOffset);
     }
     else
-    #endif
     {
-        struct sockaddr_in *dest_addr_ip4 = (struct sockaddr_in *)&pSocket->pRuntime->adapterif_addr;
-        //dest_addr_ip4->sin_addr.s_addr = pSocket->pRuntime->adapter_interface_ip_address;
-        dest_addr_ip4->sin_addr.s_addr = inet_addr(pSocket->pRuntime->cAdapterInterfaceIP);
-        dest_addr_ip4->sin_family = pSocket->address_family;
-        dest_addr_ip4->sin_port = htons(pSocket->u16Port);
+        /* bytes in the old tcp_pcb are lost - restart with the next chunk on the new connection */
+        ESP_LOGE(TAG, "Socket %s failover %d -> %d old connection not drained (%d bytes staged dropped)", pSocket->cName, nSocketOld, nSocket, pConnection->nSendBufferLength - pConnection->nSendBufferOffset);
+        pConnection->nSendBufferOffset = 0;
+        pConnection->nSendBufferLength = 0;
     }
-}
 
+    /* markers of the drained tcp_pcb are acked, the others fail - reported before the connection id becomes stale */
+    for (int nMark = pConnection->u8AckMarkCount - 1; bDrained && (nMark >= 0); nMark--)
+    {
+        if (pConnection->ackMarks[nMark].nLane == DRV_SOCKET_SEND_LANE_COUNT)
+        {
+            socket_ack_complete(pSocket, nConnectionIndex, nMark, true);
+        }
+    }
+    socket_ack_fail(pSocket, nConnectionIndex);
 
+    if (nSocketOld >= 0)
+    {
+        shutdown(nSocketOld, SHUT_RDWR);
+        close(nSocketOld);
+    }
+    if (pSocket->onConnectionClose != NULL)
+    {
+        pSocket->onConnectionClose(DRV_SOCKET_CONNECTION_ID(pConnection->u16Generation, nConnectionIndex));
+    }
+    pConnection->u16Generation++;
 
-void clear_dns_cache() 
+    pSocket->nSocketIndexPrimer[nConnectionIndex] = nSocket;
+    socket_set_options(pSocket, nConnectionIndex);
+    socket_connection_handshake_init(pSocket, nConnectionIndex);
+
+    if (pSocket->onConnectionOpen != NULL)
+    {
+        pSocket->onConnectionOpen(DRV_SOCKET_CONNECTION_ID(pConnection->u16Generation, nConnectionIndex));
+    }
+
+    pRuntime->adapter_if = pSocket->adapter_interface[pRuntime->nFailoverInterfaceIndex];
+    pRuntime->adapterif_addr = pRuntime->failover.bind_addr;
+    strcpy(pRuntime->cAdapterInterfaceIP, pRuntime->failover.cBindIP);
+    pRuntime->nFailoverInterfaceIndex = -1;
+    pRuntime->bEventsValid = false;     /* descriptor changed - select() results are stale */
+}
+
+/* switch once the unsent and unacked bytes of the old tcp_pcb reach zero (or on the drain timeout) */
+void socket_failover_drain(drv_socket_t* pSocket)
 {
-    esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
-    if (netif == NULL) {
-        printf("Failed to get netif handle\n");
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    int nConnectionIndex = socket_client_connection_index(pSocket);
+    drv_socket_tcp_info_t info;
+
+    if (nConnectionIndex < 0)
+    {
+        /* connection closed meanwhile - use the new connection as a new one */
+        int nSocket = pRuntime->nFailoverSocket;
+        pRuntime->nFailoverSocket = -1;
+        socket_timer_stop(pSocket, DRV_SOCKET_TIMER_FAILOVER_DRAIN);
+        socket_timer_stop(pSocket, DRV_SOCKET_TIMER_FAILOVER_POLL);
+        if (socket_connection_add_to_list(pSocket, nSocket) < 0) close(nSocket);
+        pRuntime->adapter_if = pSocket->adapter_interface[pRuntime->nFailoverInterfaceIndex];
+        pRuntime->nFailoverInterfaceIndex = -1;
         return;
     }
-    esp_netif_dns_info_t dns_info = {0};
-    dns_info.ip.u_addr.ip4.addr = 0;
-    esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns_info);
-    esp_netif_set_dns_info(netif, ESP_NETIF_DNS_BACKUP, &dns_info);
+
+    if (pSocket->protocol_type != DRV_SOCKET_SOCK_STREAM)
+    {
+        socket_failover_switch(pSocket, nConnectionIndex, true);
+        return;
+    }
+    if (socket_tcp_info(pSocket->nSocketIndexPrimer[nConnectionIndex], &info) == false)
+    {
+        socket_failover_switch(pSocket, nConnectionIndex, false);      /* tcp_pcb gone (reset) */
+        return;
+    }
+    if ((info.u32UnsentBytes + info.u32UnackedBytes) == 0)
+    {
+        socket_failover_switch(pSocket, nConnectionIndex, true);
+        return;
+    }
+    if (socket_timer_expired(pSocket, DRV_SOCKET_TIMER_FAILOVER_DRAIN))
+    {
+        ESP_LOGE(TAG, "Socket %s failover drain timeout (%u bytes unsent, %u unacked)", pSocket->cName, (unsigned)info.u32UnsentBytes, (unsigned)info.u32UnackedBytes);
+        socket_failover_switch(pSocket, nConnectionIndex, false);
+        return;
+    }
+    if (socket_timer_running(pSocket, DRV_SOCKET_TIMER_FAILOVER_POLL) == false)    /* not started or fired */
+    {
+        socket_timer_start(pSocket, DRV_SOCKET_TIMER_FAILOVER_POLL, pdMS_TO_TICKS(DRV_SOCKET_FAILOVER_POLL_TIME_MS));
+    }
 }
 
-/* try resolve cURL to IP Address. If not resolved - use cHostIP */
-char* socket_get_host_ip_address(drv_socket_t* pSocket)
+/* secondary connection established on the other interface - it joins the frame session with its HELLO */
+void socket_multipath_complete(drv_socket_t* pSocket, int nSocket, esp_interface_t adapter_if)
 {
-    char* pLastUsedHostIP = NULL;
-    #if CONFIG_DRV_DNS_USE
-    bool bURLResolved;
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
 
-    /* Try Resolve URL */
-    bURLResolved = false;
-    if (strlen(pSocket->cURL) > 0)
+    int nConnectionIndex = socket_connection_add_to_list(pSocket, nSocket);
+    if (nConnectionIndex < 0)
     {
-        ESP_LOGI(TAG, "Socket %s Start resolve URL %s", pSocket->cName, pSocket->cURL);
+        close(nSocket);
+        socket_timer_start(pSocket, DRV_SOCKET_TIMER_MULTIPATH_RETRY, pRuntime->nReconnectDelayTicks);
+        return;
+    }
+    ESP_LOGI(TAG, "Socket %s[%d] %d multipath secondary connected on interface %d", pSocket->cName, nConnectionIndex, nSocket, adapter_if);
+    pRuntime->nMultipathIndex = nConnectionIndex;
+    pRuntime->multipath_if = adapter_if;
+}
 
-        bURLResolved = drv_dns_resolve(pSocket->cURL, pSocket->cHostIPResolved, sizeof(pSocket->cHostIPResolved), &pSocket->bActiveTask);
-        if (bURLResolved)
-        {
-            ESP_LOGI(TAG, "Socket %s resolved URL %s to ip address: %s", pSocket->cName, pSocket->cURL, pSocket->cHostIPResolved);
-        }
-        else
-        {
-            ESP_LOGE(TAG, "Socket %s Fail resolve URL %s - use default IP: %s", pSocket->cName,pSocket->cURL, pSocket->cHostIP);
-        }
+/* failover connection established - the send stream waits until the old connection is drained */
+void socket_failover_complete(drv_socket_t* pSocket, int nSocket)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+
+    ESP_LOGI(TAG, "Socket %s failover connection %d established - drain the old connection", pSocket->cName, nSocket);
+    pRuntime->nFailoverSocket = nSocket;
+    socket_timer_start(pSocket, DRV_SOCKET_TIMER_FAILOVER_DRAIN, pdMS_TO_TICKS(DRV_SOCKET_FAILOVER_DRAIN_TIME_MS));
+    socket_failover_drain(pSocket);
+}
 
-        ESP_LOGI(TAG, "Socket %s Final resolve URL %s", pSocket->cName, pSocket->cURL); 
+/* connected client socket - move it from the connect attempt to the connection slot */
+void socket_connect_client_done(drv_socket_t* pSocket, drv_socket_connect_t* pConnect)
+{
+    int nSocket = pConnect->nSocket;
+
+    pConnect->nSocket = -1;
+    pConnect->bInProgress = false;
+    socket_timer_stop(pSocket, pConnect->nTimer);
+
+    if (pConnect == &pSocket->pRuntime->failover)
+    {
+        socket_failover_complete(pSocket, nSocket);
+        return;
     }
-
-    if(bURLResolved)  
+    if (pConnect == &pSocket->pRuntime->multipath)
     {
-        pLastUsedHostIP = pSocket->cHostIPResolved;
-    } 
-    else
-    #endif
+        socket_multipath_complete(pSocket, nSocket, pConnect->adapter_if);
+        return;
+    }
+    if (socket_race_attempt(pSocket, pConnect))
     {
-        pLastUsedHostIP = pSocket->cHostIP;
+        /* race won - remember the endpoint and drop the other attempts */
+        ESP_LOGI(TAG, "Socket %s %d endpoint %s won the connect race", pSocket->cName, nSocket, pSocket->endpoint[pConnect->nEndpointIndex].cHost);
+        pSocket->pRuntime->host_addr_main = pConnect->addr;
+        pSocket->pRuntime->nEndpointIndex = pConnect->nEndpointIndex;
+        pSocket->pRuntime->nEndpointWinner = pConnect->nEndpointIndex;
+        socket_race_stop(pSocket);
     }
 
-    return pLastUsedHostIP;
+    if (socket_connection_add_to_list(pSocket, nSocket) < 0)
+    {
+        ESP_LOGE(TAG, "Socket %s %d no free connection slot", pSocket->cName, nSocket);
+        close(nSocket);
+        socket_reconnect_time_start(pSocket);
+        return;
+    }
+    pSocket->pRuntime->bHostIPFallback = false;
+    socket_reconnect_time_reset(pSocket);
+    socket_last_good_save(pSocket);
+    pSocket->bConnected = true;
+    pSocket->bDisconnectRequest = false;
 }
 
-void socket_prepare_host_ip_info(drv_socket_t* pSocket)
+/* failed connect attempt - retry once immediately with the default ip if the resolved one was used */
+void socket_connect_client_fail(drv_socket_t* pSocket, drv_socket_connect_t* pConnect)
 {
-    char cRecvFromIP[16] = "255.255.255.255";
-    char* pRecvFromIP = cRecvFromIP;
-
-    //char cSendToIP[16] = "192.168.3.118";
-    char cSendToIP[16] = "255.255.255.255";
-    char* pSendToIP = cSendToIP;
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
 
+    pSocket->stats.u32ConnectFails++;
 
-    /* Host IP Address Preparation - host_addr_main */
-    pSocket->pRuntime->bBroadcastRxTx = false;
-    #ifdef CONFIG_EXAMPLE_IPV6
-    if (pSocket->bIPV6)
+    if (pConnect == &pRuntime->failover)
     {
-        struct sockaddr_in6 *host_addr_ip6 = (struct sockaddr_in6 *)&pSocket->pRuntime->host_addr_main;
-        host_addr_ip6->sin6_addr.un = inet_addr(pSocket->pRuntime->pLastUsedHostIP);
-        host_addr_ip6->sin6_family = pSocket->address_family;
-        host_addr_ip6->sin6_port = htons(pSocket->u16Port);
+        /* keep the current connection, retry the failover later */
+        socket_failover_stop(pSocket);
+        socket_timer_start(pSocket, DRV_SOCKET_TIMER_FAILOVER_RETRY, pRuntime->nReconnectDelayTicks);
+        return;
+    }
+    if (pConnect == &pRuntime->multipath)
+    {
+        /* single path meanwhile, retry the secondary connection later */
+        socket_connect_attempt_close(pSocket, pConnect);
+        socket_timer_start(pSocket, DRV_SOCKET_TIMER_MULTIPATH_RETRY, pRuntime->nReconnectDelayTicks);
+        return;
+    }
+    if (socket_race_attempt(pSocket, pConnect))
+    {
+        /* next endpoint started without waiting for the stagger */
+        socket_connect_attempt_close(pSocket, pConnect);
+        socket_timer_start(pSocket, DRV_SOCKET_TIMER_RACE_STAGGER, 0);
+        return;
+    }
 
-        struct sockaddr_in6 *host_addr_recv_ip6 = (struct sockaddr_in6 *)&pSocket->pRuntime->host_addr_recv;
-        host_addr_recv_ip6->sin6_addr.un = inet_addr(pRecvFromIP);
-        host_addr_recv_ip6->sin6_family = pSocket->address_family;
-        host_addr_recv_ip6->sin6_port = htons(pSocket->u16Port);
+    socket_connect_attempt_close(pSocket, pConnect);
 
-        struct sockaddr_in6 *host_addr_send_ip6 = (struct sockaddr_in6 *)&pSocket->pRuntime->host_addr_send;
-        host_addr_send_ip6->sin6_addr.un = inet_addr(pSendToIP);
-        host_addr_send_ip6->sin6_family = pSocket->address_family;
-        host_addr_send_ip6->sin6_port = htons(pSocket->u16Port);
+    if (pRuntime->bLastGoodAttempt)
+    {
+        /* stored address outdated - next attempt waits for the resolve */
+        ESP_LOGW(TAG, "Socket %s last good IP %s failed", pSocket->cName, pRuntime->lastGood.cIP);
+        pRuntime->bLastGoodAttempt = false;
+        pRuntime->bLastGoodValid = false;
     }
     else
-    #endif
+    if ((pRuntime->bHostIPFallback == false)
+     && (pRuntime->pLastUsedHostIP == pSocket->cHostIPResolved)
+     && (strcmp(pSocket->cHostIPResolved, pSocket->cHostIP) != 0))
     {
-        struct sockaddr_in *host_addr_ip4 = (struct sockaddr_in *)&pSocket->pRuntime->host_addr_main;
-        host_addr_ip4->sin_addr.s_addr = inet_addr(pSocket->pRuntime->pLastUsedHostIP);
-        host_addr_ip4->sin_family = pSocket->address_family;
-        host_addr_ip4->sin_port = htons(pSocket->u16Port);
-
-        struct sockaddr_in *host_addr_recv_ip4 = (struct sockaddr_in *)&pSocket->pRuntime->host_addr_recv;
-        host_addr_recv_ip4->sin_addr.s_addr = inet_addr(pRecvFromIP);
-        host_addr_recv_ip4->sin_family = pSocket->address_family;
-        host_addr_recv_ip4->sin_port = htons(pSocket->u16Port);
-
-        struct sockaddr_in *host_addr_send_ip4 = (struct sockaddr_in *)&pSocket->pRuntime->host_addr_send;
-        host_addr_send_ip4->sin_addr.s_addr = inet_addr(pSendToIP);
-        host_addr_send_ip4->sin_family = pSocket->address_family;
-        host_addr_send_ip4->sin_port = htons(pSocket->u16Port);
-
-        if (((host_addr_ip4->sin_addr.s_addr >> 0) & 0xFF) == 0xFF)pSocket->pRuntime->bBroadcastRxTx = true;
-        if (((host_addr_ip4->sin_addr.s_addr >> 8) & 0xFF) == 0xFF)pSocket->pRuntime->bBroadcastRxTx = true;
-        if (((host_addr_ip4->sin_addr.s_addr >>16) & 0xFF) == 0xFF)pSocket->pRuntime->bBroadcastRxTx = true;
-        if (((host_addr_ip4->sin_addr.s_addr >>24) & 0xFF) == 0xFF)pSocket->pRuntime->bBroadcastRxTx = true;
+        ESP_LOGW(TAG, "Socket %s retry connect with default IP: %s", pSocket->cName, pSocket->cHostIP);
+        pRuntime->bHostIPFallback = true;
+    }
+    else
+    {
+        pRuntime->bHostIPFallback = false;
+        socket_reconnect_time_start(pSocket);
     }
-
-    ESP_LOGI(TAG, "Socket %s Bind/Connect: %s", pSocket->cName, pSocket->pRuntime->pLastUsedHostIP); 
-    ESP_LOGI(TAG, "Socket %s RecvFrom:     %s", pSocket->cName, pRecvFromIP); 
-    ESP_LOGI(TAG, "Socket %s SendTo:       %s", pSocket->cName, pSendToIP); 
-
-
 }
 
-void socket_strt(drv_socket_t* pSocket)
+/* connect() completed - restore the requested blocking mode */
+void socket_connect_client_established(drv_socket_t* pSocket, drv_socket_connect_t* pConnect)
 {
-    int err;
-    int nSocketIndex = socket(pSocket->address_family, pSocket->protocol_type, pSocket->protocol);
+    int nSocket = pConnect->nSocket;
 
-    if (nSocketIndex < 0) 
+    ESP_LOGI(TAG, "Socket %s %d connected, port %d", pSocket->cName, nSocket, pSocket->u16Port);
+
+    int flags = fcntl(nSocket, F_GETFL, 0);
+    if (pSocket->bNonBlockingMode)
     {
-        err = errno;
-        ESP_LOGE(TAG, "Unable to create socket %s %d: errno %d (%s)", pSocket->cName, nSocketIndex, err, strerror(err));
+        ESP_LOGI(TAG, "Socket %s %d Set Non-Blocking mode", pSocket->cName, nSocket);
     }
     else
     {
-        ESP_LOGI(TAG, "Created socket %s %d: AdapterIF: %d Address Family: %d", pSocket->cName, nSocketIndex, pSocket->pRuntime->adapter_if, pSocket->address_family);
-    }
-    if (pSocket->bServerType)
-    {
-        pSocket->nSocketIndexServer = nSocketIndex;
+        fcntl(nSocket, F_SETFL, flags & ~O_NONBLOCK);
     }
-    else
+    socket_connect_client_done(pSocket, pConnect);
+}
+
+/* connect attempt target from the runtime (prepared by socket_prepare_ip_info) */
+void socket_connect_target(drv_socket_t* pSocket, drv_socket_connect_t* pConnect)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+
+    pConnect->adapter_if = pRuntime->adapter_if;
+    pConnect->nEndpointIndex = pRuntime->nEndpointIndex;
+    pConnect->addr = pRuntime->host_addr_main;
+    pConnect->bind_addr = pRuntime->adapterif_addr;
+    strcpy(pConnect->cBindIP, pRuntime->cAdapterInterfaceIP);
+    pConnect->bBroadcast = pRuntime->bBroadcastRxTx;
+}
+
+/* connect attempt target on another interface - same host as the current connection, runtime left untouched */
+void socket_connect_target_interface(drv_socket_t* pSocket, drv_socket_connect_t* pConnect, esp_interface_t adapter_if)
+{
+    in_addr_t interface_address = socket_get_interface_address(adapter_if);
+
+    socket_connect_target(pSocket, pConnect);
+    pConnect->adapter_if = adapter_if;
+    ip4addr_ntoa_r((ip4_addr_t*)&interface_address, pConnect->cBindIP, sizeof(pConnect->cBindIP));
+    if (interface_address == htonl(INADDR_NONE))
     {
-        socket_connection_add_to_list(pSocket, nSocketIndex);
-        //pSocket->nSocketIndexPrimer = nSocketIndex;
+        ESP_LOGE(TAG, "Socket %s bad or unimplemented adapter interface selected: %d", pSocket->cName, adapter_if);
     }
+
+    struct sockaddr_in *bind_addr_ip4 = (struct sockaddr_in *)&pConnect->bind_addr;
+    bind_addr_ip4->sin_addr.s_addr = interface_address;
+    bind_addr_ip4->sin_family = pSocket->address_family;
+    bind_addr_ip4->sin_port = htons(pSocket->u16Port);
 }
 
-void socket_connect_server_periodic(drv_socket_t* pSocket)
+void socket_connect_client(drv_socket_t* pSocket, drv_socket_connect_t* pConnect)
 {
-    int err;
+    int nSocket = pConnect->nSocket;
 
+    int err = 0 ;
 
-    ESP_LOGD(TAG, "Socket %s %d periodic check incoming connections", pSocket->cName, pSocket->nSocketIndexServer);
+    int opt = 1 ;
+    socklen_t optlen = sizeof ( opt ) ;
 
-    struct sockaddr_storage source_addr; // Large enough for both IPv4 or IPv6
-    socklen_t addr_len = sizeof(source_addr);
+    // getsockopt()
+    int ret_so;
+    ret_so = getsockopt ( nSocket , SOL_SOCKET, SO_REUSEADDR, ( void * ) & opt, & optlen ) ;
+    if ( ret_so < 0 ) {
+        err = errno ;
+        ESP_LOGE (TAG, LOG_COLOR ( LOG_COLOR_CYAN ) "Socket %s %d getsockopt  SO_REUSEADDR=%d retv = %d. errno %d (%s)", pSocket -> cName, nSocket, opt, ret_so, err, strerror ( errno ) ) ;
+    }
 
-    // Set a timeout of 0 ms
-    struct timeval timeout;
-    timeout.tv_sec = 0;
-    timeout.tv_usec = 0;
+    // setsockopt()
+    opt = 1;
+    ret_so = setsockopt ( nSocket , SOL_SOCKET, SO_REUSEADDR, ( void * ) & opt, sizeof ( opt ) ) ;
+    if ( ret_so < 0 ) {
+        err = errno ;
+        ESP_LOGE (TAG, LOG_COLOR ( LOG_COLOR_CYAN ) "Socket %s %d setsockopt  SO_REUSEADDR=%d retv = %d. errno %d (%s)", pSocket -> cName, nSocket, opt, ret_so, err, strerror ( errno ) ) ;
+    }
 
-    // Set the socket to non-blocking mode
-    fcntl(pSocket->nSocketIndexServer, F_SETFL, O_NONBLOCK);
 
-    // Use select() to wait for the socket to become readable or for the timeout to expire
-    fd_set rfds;
-    FD_ZERO(&rfds);
-    FD_SET(pSocket->nSocketIndexServer, &rfds);
-    int ready = select(pSocket->nSocketIndexServer + 1, &rfds, NULL, NULL, &timeout);
 
-    if (ready < 0) 
-    {
-        ESP_LOGE(TAG, "Socket %s %d Error in select() function: errno %d (%s)", pSocket->cName, pSocket->nSocketIndexServer, errno, strerror(errno));
-        socket_disconnect(pSocket);
-        //close(pSocket->nSocketIndexServer);
-        //pSocket->nSocketIndexServer = -1;
-    } 
-    else if (ready == 0) 
+    // bind
+    /* client bind is not necessary because an auto bind will take place at first send/recv/sendto/recvfrom using a system assigned local port */
+    int eError = bind(nSocket, (struct sockaddr *)&pConnect->bind_addr, sizeof(pConnect->bind_addr));
+    if (eError != 0) 
     {
-        if ((pSocket->nTaskLoopCounter % ((pdMS_TO_TICKS(30000)) / nTaskRestTimeTicks)) == 0)
-        {
-            ESP_LOGW(TAG, "Socket %s %d Timeout waiting for client to connect", pSocket->cName, pSocket->nSocketIndexServer);
-        }
-        //socket_disconnect(pSocket);
-        //close(pSocket->nSocketIndexServer);
-        //pSocket->nSocketIndexServer = -1;
-    } 
-    else 
+        err = errno;
+        ESP_LOGE(TAG, "Socket %s %d unable to bind: errno %d (%s)", pSocket->cName, nSocket, err, strerror(err));
+        socket_connect_client_fail(pSocket, pConnect);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Socket %s %d bound to IF %s:%d", pSocket->cName, nSocket, pConnect->cBindIP, pSocket->u16Port);
+
+    /* Connect to the host by the network interface */
+    if (pConnect->bBroadcast == false)
     {
-        int nNewSocketClientIndex = accept(pSocket->nSocketIndexServer, (struct sockaddr *)&source_addr, &addr_len);
-        if (nNewSocketClientIndex < 0) 
+
+        char IP_target [ 16 ] ;
+        /*
+        char PORT_target [ 10 ] ;
+        getnameinfo ( ( struct sockaddr * ) & pSocket -> pRuntime -> host_addr_main, sizeof ( pSocket -> pRuntime -> host_addr_main ), IP_target, sizeof ( IP_target ), PORT_target, sizeof ( PORT_target ), NI_NUMERICHOST | NI_NUMERICSERV ) ;
+        */
+        inet_ntoa_r ( ( ( struct sockaddr_in * ) & pConnect -> addr ) -> sin_addr . s_addr, IP_target, sizeof ( IP_target ) - 1 ) ;
+        ESP_LOGI (TAG, "trying connect() to REMOTE IP:PORT = %s:%u", IP_target, ntohs(( ( struct sockaddr_in * ) & pConnect -> addr ) -> sin_port )) ; // 192.168.0.3 : 64520 ( network byte order == LS byte 1st )        64520 ( LS Byte 1st ) == 2300 ( MS Byte 1st )
+
+        /* connect in non-blocking mode - completion checked by socket_connect_client_check() */
+        int flags = fcntl(nSocket, F_GETFL, 0);
+        fcntl(nSocket, F_SETFL, flags | O_NONBLOCK);
+
+        eError = connect(nSocket, (struct sockaddr *)&pConnect->addr, sizeof(pConnect->addr));
+        if (eError == 0)
         {
-            err = errno;
-            ESP_LOGE(TAG, "Socket %s %d Unable to accept connection %d: errno %d (%s)", pSocket->cName, pSocket->nSocketIndexServer, nNewSocketClientIndex, err, strerror(err));
-            //socket_disconnect(pSocket); //To Do check not to disconnect socket if no more connections available
-            //close(pSocket->nSocketIndexServer);
-            //pSocket->nSocketIndexServer = -1;
+            socket_connect_client_established(pSocket, pConnect);
         }
         else
         {
-            char addr_str[128];
-            if (source_addr.ss_family == PF_INET) 
-            {
-                inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr, addr_str, sizeof(addr_str) - 1);
-            }
-            else if (source_addr.ss_family == PF_INET6) 
+            err = errno;
+            if (err == EINPROGRESS)
             {
-                #if LWIP_IPV6
-                inet6_ntoa_r(((struct sockaddr_in6 *)&source_addr)->sin6_addr, addr_str, sizeof(addr_str) - 1);
-                #else
-                ESP_LOGE(TAG, "Socket %s %d IPv6 Need LWIP_IPV6 defined", pSocket->cName, pSocket->nSocketIndexServer);
-                #endif
+                int nConnectTimeoutMs = pSocket->nConnectTimeoutMs;
+                if (nConnectTimeoutMs <= 0)
+                {
+                    nConnectTimeoutMs = DRV_SOCKET_CONNECT_TIMEOUT_MS;
+                }
+                pConnect->bInProgress = true;
+                socket_timer_start(pSocket, pConnect->nTimer, pdMS_TO_TICKS(nConnectTimeoutMs));
+                ESP_LOGI(TAG, "Socket %s %d connect in progress (timeout %d ms)", pSocket->cName, nSocket, nConnectTimeoutMs);
             }
-            ESP_LOGI(TAG, "Socket %s %d accepted ip address: %s", pSocket->cName, pSocket->nSocketIndexServer, addr_str);
-
-            if (socket_connection_add_to_list(pSocket, nNewSocketClientIndex))
+            else
             {
-                pSocket->nSocketIndexPrimerIP[pSocket->nSocketConnectionsCount-1] = source_addr;
+                ESP_LOGE(TAG, "Socket %s %d unable to connect: errno %d (%s)", pSocket->cName, nSocket, err, strerror(err));
+                socket_connect_client_fail(pSocket, pConnect);
             }
-            
-            //pSocket->nSocketIndexPrimer = nNewSocketClientIndex;
         }
     }
-    // Set the socket back to blocking mode
-    fcntl(pSocket->nSocketIndexServer, F_SETFL, 0);
-
+    else
+    {
+        ESP_LOGI(TAG, "Socket %s %d connected only through bind (broadcast host address detected), port %d", pSocket->cName, nSocket, pSocket->u16Port);
+        socket_connect_client_done(pSocket, pConnect);
+    }
 }
 
-void socket_connect_server(drv_socket_t* pSocket)
+/* pending connect attempt - check completion, interface change and deadline */
+void socket_connect_client_check(drv_socket_t* pSocket, drv_socket_connect_t* pConnect, bool bValidInterface)
 {
-    int err = 0;
-
-    int opt = 1;
-    socklen_t optlen = sizeof(opt);
+    int nSocket = pConnect->nSocket;
+    bool bWritable;
 
-    int ret_so;
+    if (bValidInterface == false)
+    {
+        ESP_LOGW(TAG, "Socket %s %d interface changed - abandon connect attempt", pSocket->cName, nSocket);
+        socket_connect_attempt_close(pSocket, pConnect);     /* new interface tried on the next loop */
+        return;
+    }
 
-    ret_so = getsockopt( pSocket->nSocketIndexServer , SOL_SOCKET, SO_REUSEADDR,(void*)&opt, &optlen);
-    if (ret_so < 0)
+    if (pSocket->pRuntime->bEventsValid)
     {
-        err = errno;
-        ESP_LOGE(TAG, LOG_COLOR(LOG_COLOR_CYAN)"Socket %s %d getsockopt  SO_REUSEADDR=%d retv = %d. errno %d (%s)", pSocket->cName, pSocket->nSocketIndexServer, opt, ret_so, err, strerror(errno));
+        bWritable = FD_ISSET(nSocket, &pSocket->pRuntime->wfds);
+    }
+    else
+    {
+        fd_set wfds;
+        struct timeval timeout = { 0 };
+        FD_ZERO(&wfds);
+        FD_SET(nSocket, &wfds);
+        bWritable = (select(nSocket + 1, NULL, &wfds, NULL, &timeout) > 0);
     }
 
-    opt = 1;
-    ret_so = setsockopt( pSocket->nSocketIndexServer , SOL_SOCKET, SO_REUSEADDR,(void*)&opt, sizeof(opt));
-    if (ret_so < 0)
+    if (bWritable)
     {
-        err = errno;
-        ESP_LOGE(TAG, LOG_COLOR(LOG_COLOR_CYAN)"Socket %s %d setsockopt  SO_REUSEADDR=%d retv = %d. errno %d (%s)", pSocket->cName, pSocket->nSocketIndexServer, opt, ret_so, err, strerror(errno));
+        int err = 0;
+        socklen_t optlen = sizeof(err);
+        if (getsockopt(nSocket, SOL_SOCKET, SO_ERROR, (void*)&err, &optlen) < 0)
+        {
+            err = errno;
+        }
+        if (err == 0)
+        {
+            socket_connect_client_established(pSocket, pConnect);
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Socket %s %d unable to connect: errno %d (%s)", pSocket->cName, nSocket, err, strerror(err));
+            socket_connect_client_fail(pSocket, pConnect);
+        }
+    }
+    else
+    if (socket_timer_expired(pSocket, pConnect->nTimer))
+    {
+        ESP_LOGE(TAG, "Socket %s %d connect timeout", pSocket->cName, nSocket);
+        socket_connect_client_fail(pSocket, pConnect);
     }
+}
 
-    //vTaskDelay(pdMS_TO_TICKS(100));
 
+/* make-before-break failover - connect on the target interface while the current connection keeps running */
+void socket_failover_periodic(drv_socket_t* pSocket)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    drv_socket_connect_t* pConnect = &pRuntime->failover;
+    int nInterfaceIndex = pRuntime->nFailoverInterfaceIndex;
 
+    if ((pRuntime->abInterfaceConnected[nInterfaceIndex] == false) || (pSocket->bConnected == false))
+    {
+        ESP_LOGW(TAG, "Socket %s failover target interface lost - cancel failover", pSocket->cName);
+        socket_failover_stop(pSocket);
+        return;
+    }
 
-    int eError = bind(pSocket->nSocketIndexServer, (struct sockaddr *)&pSocket->pRuntime->adapterif_addr, sizeof(pSocket->pRuntime->adapterif_addr));
-    if (eError != 0) 
+    if (pRuntime->nFailoverSocket >= 0)
     {
-        err = errno;
-        ESP_LOGE(TAG, "Socket %s %d unable to bind: errno %d (%s)", pSocket->cName, pSocket->nSocketIndexServer, err, strerror(err));
+        socket_failover_drain(pSocket);
+    }
+    else
+    if (pConnect->bInProgress)
+    {
+        socket_connect_client_check(pSocket, pConnect, true);
+    }
+    else
+    if (pConnect->nSocket < 0)
+    {
+        pConnect->nSocket = socket(pSocket->address_family, pSocket->protocol_type, pSocket->protocol);
+        if (pConnect->nSocket < 0)
+        {
+            int err = errno;
+            ESP_LOGE(TAG, "Unable to create failover socket %s: errno %d (%s)", pSocket->cName, err, strerror(err));
+            socket_connect_client_fail(pSocket, pConnect);
+            return;
+        }
+        ESP_LOGI(TAG, "Created failover socket %s %d: AdapterIF: %d", pSocket->cName, pConnect->nSocket, pSocket->adapter_interface[nInterfaceIndex]);
 
-        struct sockaddr_in *test_addr_ip4 = (struct sockaddr_in *)&pSocket->pRuntime->adapterif_addr;
-        //dest_addr_ip4->sin_addr.s_addr = pSocket->pRuntime->adapter_interface_ip_address;
+        /* bind and connect through the target interface - the live connection keeps its runtime address info */
+        socket_connect_target_interface(pSocket, pConnect, pSocket->adapter_interface[nInterfaceIndex]);
+        socket_connect_client(pSocket, pConnect);
+    }
+}
 
-        in_addr_t interfaceAddress = test_addr_ip4->sin_addr.s_addr;
-        const ip4_addr_t* pInterfaceAddress = (const ip4_addr_t*)&interfaceAddress;
-        char cAdapterInterfaceIP[16];
-        char *adapter_interface_ip = ip4addr_ntoa_r(pInterfaceAddress, cAdapterInterfaceIP, sizeof(cAdapterInterfaceIP));
-        ESP_LOGW(TAG, "Socket %s %d adapterif addr:%s port:%d family:%d", pSocket->cName, pSocket->nSocketIndexServer, adapter_interface_ip, htons(test_addr_ip4->sin_port), test_addr_ip4->sin_family);
-        
-        socket_disconnect(pSocket);
-        //close(pSocket->nSocketIndexServer);
-        //pSocket->nSocketIndexServer = -1;
+/* multipath client - keep a secondary connection on the other interface and select the connection the frames are staged on */
+void socket_multipath_periodic(drv_socket_t* pSocket)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    drv_socket_connect_t* pConnect = &pRuntime->multipath;
+
+    int nInterfaceIndex = DRV_SOCKET_ADAPTER_INTERFACE_BACKUP;
+    if (pRuntime->adapter_if == pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_BACKUP])
+    {
+        nInterfaceIndex = DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT;
+    }
+    esp_interface_t multipath_if = pSocket->adapter_interface[nInterfaceIndex];
+    bool bValidInterface = pRuntime->abInterfaceConnected[nInterfaceIndex] && (multipath_if != pRuntime->adapter_if);
+
+    if (pConnect->bInProgress)
+    {
+        socket_connect_client_check(pSocket, pConnect, bValidInterface && (pConnect->adapter_if == multipath_if));
     }
     else
+    if ((pRuntime->nMultipathIndex < 0) && (pConnect->nSocket < 0) && bValidInterface && (DRV_SOCKET_SERVER_MAX_CLIENTS > 1)
+     && (socket_timer_running(pSocket, DRV_SOCKET_TIMER_MULTIPATH_RETRY) == false))
     {
-        ESP_LOGI(TAG, "Socket %s %d bound to IF %s:%d", pSocket->cName, pSocket->nSocketIndexServer, pSocket->pRuntime->cAdapterInterfaceIP, pSocket->u16Port);
-
-        eError = listen(pSocket->nSocketIndexServer, 1);
-        if (eError != 0) 
+        pConnect->nSocket = socket(pSocket->address_family, pSocket->protocol_type, pSocket->protocol);
+        if (pConnect->nSocket < 0)
         {
-            err = errno;
-            ESP_LOGE(TAG, "Error occurred during listen socket %s %d: errno %d (%s)", pSocket->cName, pSocket->nSocketIndexServer, err, strerror(err));
-            socket_disconnect(pSocket);
-            //close(pSocket->nSocketIndexServer);
-            //pSocket->nSocketIndexServer = -1;
+            int err = errno;
+            ESP_LOGE(TAG, "Unable to create multipath socket %s: errno %d (%s)", pSocket->cName, err, strerror(err));
+            socket_connect_client_fail(pSocket, pConnect);
         }
         else
         {
-            ESP_LOGI(TAG, "Socket %s %d listening", pSocket->cName, pSocket->nSocketIndexServer);
-
-            struct sockaddr_storage source_addr; // Large enough for both IPv4 or IPv6
-            socklen_t addr_len = sizeof(source_addr);
-
-            // Set a timeout of 30 seconds
-            struct timeval timeout;
-            timeout.tv_sec = 30;
-            timeout.tv_usec = 0;
+            ESP_LOGI(TAG, "Created multipath socket %s %d: AdapterIF: %d", pSocket->cName, pConnect->nSocket, multipath_if);
 
-            // Set the socket to non-blocking mode
-            fcntl(pSocket->nSocketIndexServer, F_SETFL, O_NONBLOCK);
+            /* bind and connect through the other interface - same host as the primary connection */
+            socket_connect_target_interface(pSocket, pConnect, multipath_if);
+            socket_connect_client(pSocket, pConnect);
+        }
+    }
 
-            // Use select() to wait for the socket to become readable or for the timeout to expire
-            fd_set rfds;
-            FD_ZERO(&rfds);
-            FD_SET(pSocket->nSocketIndexServer, &rfds);
-            int ready = select(pSocket->nSocketIndexServer + 1, &rfds, NULL, NULL, &timeout);
+    /* active connection - primary, or the lower rtt one when steering (frames switch path at frame boundaries) */
+    int nPrimaryIndex = socket_client_connection_index(pSocket);
+    int nSecondaryIndex = pRuntime->nMultipathIndex;
+    int nActiveIndex = pRuntime->nMultipathActiveIndex;
 
-            if (ready < 0) 
-            {
-                ESP_LOGE(TAG, "Socket %s %d Error in select() function: errno %d (%s)", pSocket->cName, pSocket->nSocketIndexServer, errno, strerror(errno));
-                socket_disconnect(pSocket);
-                //close(pSocket->nSocketIndexServer);
-                //pSocket->nSocketIndexServer = -1;
-            } 
-            else if (ready == 0) 
-            {
-                ESP_LOGW(TAG, "Socket %s %d Timeout waiting for client to connect", pSocket->cName, pSocket->nSocketIndexServer);
-                //socket_disconnect(pSocket);
-                //close(pSocket->nSocketIndexServer);
-                //pSocket->nSocketIndexServer = -1;
-            } 
-            else 
-            {
-                int nNewSocketClientIndex = accept(pSocket->nSocketIndexServer, (struct sockaddr *)&source_addr, &addr_len);
-                if (nNewSocketClientIndex < 0) 
-                {
-                    err = errno;
-                    ESP_LOGE(TAG, "Socket %s %d Unable to accept connection %d: errno %d (%s)", pSocket->cName, pSocket->nSocketIndexServer, nNewSocketClientIndex, err, strerror(err));
-                    socket_disconnect(pSocket);
-                    //close(pSocket->nSocketIndexServer);
-                    //pSocket->nSocketIndexServer = -1;
-                }
-                else
-                {
-                    char addr_str[128];
-                    if (source_addr.ss_family == PF_INET) 
-                    {
-                        inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr, addr_str, sizeof(addr_str) - 1);
-                    }
-                    else if (source_addr.ss_family == PF_INET6) 
-                    {
-                        #if LWIP_IPV6
-                        inet6_ntoa_r(((struct sockaddr_in6 *)&source_addr)->sin6_addr, addr_str, sizeof(addr_str) - 1);
-                        #else
-                        ESP_LOGE(TAG, "Socket %s %d IPv6 Need LWIP_IPV6 defined", pSocket->cName, pSocket->nSocketIndexServer);
-                        #endif
-                    }
-                    ESP_LOGI(TAG, "Socket %s %d accepted ip address: %s", pSocket->cName, pSocket->nSocketIndexServer, addr_str);
+    if ((pSocket->multipath != DRV_SOCKET_MULTIPATH_STEER_RTT) || (nPrimaryIndex < 0) || (nSecondaryIndex < 0))
+    {
+        nActiveIndex = nPrimaryIndex;
+    }
+    else
+    if (socket_timer_running(pSocket, DRV_SOCKET_TIMER_MULTIPATH_STEER) == false)
+    {
+        drv_socket_tcp_info_t primary;
+        drv_socket_tcp_info_t secondary;
 
-                    if (socket_connection_add_to_list(pSocket, nNewSocketClientIndex))
-                    {
-                        pSocket->nSocketIndexPrimerIP[pSocket->nSocketConnectionsCount-1] = source_addr;
-                    }
-                     //pSocket->nSocketIndexPrimer = nNewSocketClientIndex;
-                }
-            }
-            // Set the socket back to blocking mode
-            fcntl(pSocket->nSocketIndexServer, F_SETFL, 0);
+        socket_timer_start(pSocket, DRV_SOCKET_TIMER_MULTIPATH_STEER, pdMS_TO_TICKS(DRV_SOCKET_MULTIPATH_STEER_TIME_MS));
+        if (socket_tcp_info(pSocket->nSocketIndexPrimer[nPrimaryIndex], &primary) && socket_tcp_info(pSocket->nSocketIndexPrimer[nSecondaryIndex], &secondary)
+         && (primary.nRttMs >= 0) && (secondary.nRttMs >= 0) && pRuntime->connection[nSecondaryIndex].bSendEnable)
+        {
+            /* switched only on a strictly lower rtt */
+            if (primary.nRttMs < secondary.nRttMs) nActiveIndex = nPrimaryIndex;
+            if (secondary.nRttMs < primary.nRttMs) nActiveIndex = nSecondaryIndex;
         }
     }
-}
-
-void socket_connect_client(drv_socket_t* pSocket)
-{
-    if (pSocket->nSocketConnectionsCount != 1)
+    if ((nActiveIndex < 0) || (pSocket->nSocketIndexPrimer[nActiveIndex] < 0))
     {
-        ESP_LOGE(TAG, "Socket %s unexpected client type with %d connections ", pSocket->cName, pSocket->nSocketConnectionsCount);
+        nActiveIndex = nPrimaryIndex;
     }
-    else
+
+    if ((nActiveIndex >= 0) && (pRuntime->nMultipathActiveIndex != nActiveIndex))
     {
+        ESP_LOGI(TAG, "Socket %s multipath active connection %d -> %d", pSocket->cName, pRuntime->nMultipathActiveIndex, nActiveIndex);
+        pRuntime->nMultipathActiveIndex = nActiveIndex;
+    }
+}
+
+/* endpoint index of a race position - the last winner first, then the others in order */
+int socket_race_endpoint(drv_socket_t* pSocket, int nPosition)
+{
+    int nWinner = pSocket->pRuntime->nEndpointWinner;
+
+    if ((nWinner < 0) || (nWinner >= pSocket->nEndpointCount)) return nPosition;
+    if (nPosition == 0) return nWinner;
+    return (nPosition <= nWinner) ? (nPosition - 1) : nPosition;
+}
 
-        int nConnectionIndex = 0 ;
-        
-        int err = 0 ;
+void socket_race_start(drv_socket_t* pSocket)
+{
+    ESP_LOGW(TAG, "socket client %s: Race Connect %d Endpoints", pSocket->cName, pSocket->nEndpointCount);
+    pSocket->pRuntime->bRacing = true;
+    pSocket->pRuntime->nRaceNext = 0;
+    socket_timer_start(pSocket, DRV_SOCKET_TIMER_RACE_STAGGER, 0);
+}
 
-        int opt = 1 ;
-        socklen_t optlen = sizeof ( opt ) ;
+/* happy eyeballs - start the endpoints staggered (next one at once if an attempt fails), first connected wins */
+void socket_race_periodic(drv_socket_t* pSocket, bool bSelectedValidInterface)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    drv_socket_connect_t* pConnectFree = NULL;
+    bool bAttemptActive = false;
 
-        // getsockopt()
-        int ret_so;
-        ret_so = getsockopt ( pSocket->nSocketIndexPrimer[nConnectionIndex] , SOL_SOCKET, SO_REUSEADDR, ( void * ) & opt, & optlen ) ;
-        if ( ret_so < 0 ) {
-            err = errno ;
-            ESP_LOGE (TAG, LOG_COLOR ( LOG_COLOR_CYAN ) "Socket %s %d getsockopt  SO_REUSEADDR=%d retv = %d. errno %d (%s)", pSocket -> cName, pSocket->nSocketIndexPrimer[nConnectionIndex], opt, ret_so, err, strerror ( errno ) ) ;
+    for (int nIndex = 0; nIndex < DRV_SOCKET_CONNECT_RACE_COUNT; nIndex++)
+    {
+        drv_socket_connect_t* pConnect = &pRuntime->race[nIndex];
+        if (pConnect->bInProgress)
+        {
+            socket_connect_client_check(pSocket, pConnect, bSelectedValidInterface && (pConnect->adapter_if == pRuntime->adapter_if));
+            if (pRuntime->bRacing == false) return;     /* connected */
         }
-
-        // setsockopt()
-        opt = 1;
-        ret_so = setsockopt ( pSocket->nSocketIndexPrimer[nConnectionIndex] , SOL_SOCKET, SO_REUSEADDR, ( void * ) & opt, sizeof ( opt ) ) ;
-        if ( ret_so < 0 ) {
-            err = errno ;
-            ESP_LOGE (TAG, LOG_COLOR ( LOG_COLOR_CYAN ) "Socket %s %d setsockopt  SO_REUSEADDR=%d retv = %d. errno %d (%s)", pSocket -> cName, pSocket->nSocketIndexPrimer[nConnectionIndex], opt, ret_so, err, strerror ( errno ) ) ;
+        if (pConnect->nSocket >= 0)
+        {
+            bAttemptActive = true;
         }
+        else
+        if (pConnectFree == NULL)
+        {
+            pConnectFree = pConnect;
+        }
+    }
 
+    if ((pConnectFree != NULL) && bSelectedValidInterface && (pRuntime->nRaceNext < pSocket->nEndpointCount)
+     && socket_timer_expired(pSocket, DRV_SOCKET_TIMER_RACE_STAGGER))
+    {
+        int nEndpointIndex = socket_race_endpoint(pSocket, pRuntime->nRaceNext++);
+        socket_timer_start(pSocket, DRV_SOCKET_TIMER_RACE_STAGGER, pdMS_TO_TICKS(DRV_SOCKET_CONNECT_RACE_STAGGER_MS));
 
-
-        // bind
-        /* client bind is not necessary because an auto bind will take place at first send/recv/sendto/recvfrom using a system assigned local port */
-        int eError = bind(pSocket->nSocketIndexPrimer[nConnectionIndex], (struct sockaddr *)&pSocket->pRuntime->adapterif_addr, sizeof(pSocket->pRuntime->adapterif_addr));
-        if (eError != 0) 
+        if (socket_endpoint_get_ip(pSocket, nEndpointIndex, pRuntime->cEndpointIP, sizeof(pRuntime->cEndpointIP)) == false)
         {
-            err = errno;
-            ESP_LOGE(TAG, "Socket %s %d unable to bind: errno %d (%s)", pSocket->cName, pSocket->nSocketIndexPrimer[nConnectionIndex], err, strerror(err));
-            socket_disconnect(pSocket);
-            //close(pSocket->nSocketIndexPrimer);
-            //pSocket->nSocketIndexPrimer = -1;
+            ESP_LOGE(TAG, "Socket %s endpoint %s not resolved - skipped", pSocket->cName, pSocket->endpoint[nEndpointIndex].cHost);
+            socket_timer_start(pSocket, DRV_SOCKET_TIMER_RACE_STAGGER, 0);
         }
         else
         {
-            ESP_LOGI(TAG, "Socket %s %d bound to IF %s:%d", pSocket->cName, pSocket->nSocketIndexPrimer[nConnectionIndex], pSocket->pRuntime->cAdapterInterfaceIP, pSocket->u16Port);
-
-            /* Connect to the host by the network interface */
-            if (pSocket->pRuntime->bBroadcastRxTx == false)
+            pConnectFree->nSocket = socket(pSocket->address_family, pSocket->protocol_type, pSocket->protocol);
+            if (pConnectFree->nSocket < 0)
             {
-
-                char IP_target [ 16 ] ;
-                /*
-                char PORT_target [ 10 ] ;
-                getnameinfo ( ( struct sockaddr * ) & pSocket -> pRuntime -> host_addr_main, sizeof ( pSocket -> pRuntime -> host_addr_main ), IP_target, sizeof ( IP_target ), PORT_target, sizeof ( PORT_target ), NI_NUMERICHOST | NI_NUMERICSERV ) ;
-                */
-                inet_ntoa_r ( ( ( struct sockaddr_in * ) & pSocket -> pRuntime -> host_addr_main ) -> sin_addr . s_addr, IP_target, sizeof ( IP_target ) - 1 ) ;
-                ESP_LOGI (TAG, "trying connect() to REMOTE IP:PORT = %s:%u", IP_target, ntohs(( ( struct sockaddr_in * ) & pSocket -> pRuntime -> host_addr_main ) -> sin_port )) ; // 192.168.0.3 : 64520 ( network byte order == LS byte 1st )        64520 ( LS Byte 1st ) == 2300 ( MS Byte 1st )
-
-
-
-                int eError = connect(pSocket->nSocketIndexPrimer[nConnectionIndex], (struct sockaddr *)&pSocket->pRuntime->host_addr_main, sizeof(pSocket->pRuntime->host_addr_main));
-                if (eError != 0) 
-                {
-                    err = errno;
-                    ESP_LOGE(TAG, "Socket %s %d unable to connect: errno %d (%s)", pSocket->cName, pSocket->nSocketIndexPrimer[nConnectionIndex], err, strerror(err));
-                    socket_disconnect(pSocket);
-                    //close(pSocket->nSocketIndexPrimer);
-                    //pSocket->nSocketIndexPrimer = -1; 
-                }
-                else
-                {
-                    ESP_LOGI(TAG, "Socket %s %d connected, port %d", pSocket->cName, pSocket->nSocketIndexPrimer[nConnectionIndex], pSocket->u16Port);
-
-                    if (pSocket->bNonBlockingMode)
-                    {
-
-                        // Set socket to non-blocking mode
-                        int socket_fd = pSocket->nSocketIndexPrimer[nConnectionIndex];
-                        int flags = fcntl(socket_fd, F_GETFL, 0);
-                        fcntl(socket_fd, F_SETFL, flags | O_NONBLOCK);
-                        ESP_LOGI(TAG, "Socket %s %d Set Non-Blocking mode", pSocket->cName, pSocket->nSocketIndexPrimer[nConnectionIndex]);
-                    }
-                }
+                int err = errno;
+                ESP_LOGE(TAG, "Unable to create race socket %s: errno %d (%s)", pSocket->cName, err, strerror(err));
             }
             else
             {
-                ESP_LOGI(TAG, "Socket %s %d connected only through bind (broadcast host address detected), port %d", pSocket->cName, pSocket->nSocketIndexPrimer[nConnectionIndex], pSocket->u16Port);
+                ESP_LOGW(TAG, "socket client %s %d: Try Connect Endpoint %s", pSocket->cName, pConnectFree->nSocket, pSocket->endpoint[nEndpointIndex].cHost);
+                pRuntime->nEndpointIndex = nEndpointIndex;
+                socket_prepare_ip_info(pSocket);
+                socket_connect_target(pSocket, pConnectFree);
+                socket_connect_client(pSocket, pConnectFree);
+                if (pRuntime->bRacing == false) return;     /* connected at once */
+                if (pConnectFree->nSocket >= 0) bAttemptActive = true;
             }
         }
     }
+
+    if ((bAttemptActive == false) && (pRuntime->nRaceNext >= pSocket->nEndpointCount))
+    {
+        ESP_LOGE(TAG, "Socket %s all %d endpoints failed", pSocket->cName, pSocket->nEndpointCount);
+        pRuntime->bRacing = false;
+        pRuntime->bLastGoodValid = false;       /* next race waits for the resolve */
+        pRuntime->nEndpointIndex = -1;
+        socket_reconnect_time_start(pSocket);
+    }
 }
 
 void socket_prepare_ip_info(drv_socket_t* pSocket)
@@ -1436,6 +4109,7 @@ void socket_prepare_ip_info(drv_socket_t* pSocket)
     socket_get_adapter_interface_ip(pSocket);
     socket_prepare_adapter_interface_ip_info(pSocket);
 
+    pSocket->pRuntime->u16HostPort = pSocket->u16Port;
     pSocket->pRuntime->pLastUsedHostIP = socket_get_host_ip_address(pSocket);
     socket_prepare_host_ip_info(pSocket);
 }
@@ -1466,7 +4140,18 @@ void socket_set_options(drv_socket_t* pSocket, int nConnectionIndex)
         }
     }
 
-    if (pSocket->protocol_type == SOCK_STREAM)   /* if TCP */
+    if ((pSocket->protocol_type == DRV_SOCKET_SOCK_STREAM) && (pSocket->bNoDelay || (pSocket->nCoalesceSize > 0)))
+    {
+        /* segments formed by the coalescing (or each write) instead of Nagle */
+        int noDelay = 1;
+        if (setsockopt(pSocket->nSocketIndexPrimer[nConnectionIndex], IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(int)) < 0)
+        {
+            err = errno;
+            ESP_LOGE(TAG, "Socket %s[%d] %d Failed to set sock option no delay: errno %d (%s)", pSocket->cName, nConnectionIndex, pSocket->nSocketIndexPrimer[nConnectionIndex], err, strerror(err));
+        }
+    }
+
+    if (pSocket->protocol_type == DRV_SOCKET_SOCK_STREAM)   /* if TCP */
     {
         // Set tcp keepalive option
         int keepAlive = 1;
@@ -1502,9 +4187,14 @@ void socket_set_options(drv_socket_t* pSocket, int nConnectionIndex)
 
 void socket_on_connect(drv_socket_t* pSocket, int nConnectionIndex)
 {
-    if (pSocket->bResetSendStreamOnConnect)
+    int nStreamIndex = socket_stream_index(pSocket, nConnectionIndex);
+
+    if (pSocket->bResetSendStreamOnConnect && socket_stream_new(pSocket))
     {
-        drv_stream_zero(pSocket->pSendStreamBuffer[nConnectionIndex]);
+        drv_stream_zero(pSocket->pSendStreamBuffer[nStreamIndex]);
+        if (pSocket->pSendStreamBufferControl[nStreamIndex] != NULL) drv_stream_zero(pSocket->pSendStreamBufferControl[nStreamIndex]);
+        if (pSocket->pSendStreamBufferBulk[nStreamIndex] != NULL) drv_stream_zero(pSocket->pSendStreamBufferBulk[nStreamIndex]);
+        pSocket->pRuntime->nFrameSendLength = -1;
     }
 
     //drv_stream_zero(pSocket->pRecvStreamBuffer[nConnectionIndex]);
@@ -1513,35 +4203,58 @@ void socket_on_connect(drv_socket_t* pSocket, int nConnectionIndex)
     {
         pSocket->onConnect(nConnectionIndex);
     }
-    
 
-    pSocket->bIndentifyNeeded = pSocket->bIndentifyForced;
-    if (pSocket->bIndentifyNeeded)
+    socket_connection_handshake_init(pSocket, nConnectionIndex);
+}
+
+/* handshake, ping and send enable state of a new connection */
+void socket_connection_handshake_init(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    drv_socket_connection_t* pConnection = &pSocket->pRuntime->connection[nConnectionIndex];
+
+    /* framed connections start with the HELLO frame - no identification text */
+    pConnection->nFrameBufferLength = 0;
+    pConnection->bFrameParked = false;
+    pConnection->bFrameHello = socket_multipath_framed(pSocket);
+    pConnection->bIndentifyNeeded = pSocket->bIndentifyForced && (pConnection->bFrameHello == false);
+    if (pConnection->bIndentifyNeeded)
     {
-        pSocket->bSendEnable = false;
+        pConnection->bSendEnable = false;
     }
     else
     {
-        pSocket->bSendEnable = pSocket->bAutoSendEnable;
+        pConnection->bSendEnable = pSocket->bAutoSendEnable;
     }
     
-    pSocket->nTimeoutSendEnable = 0;
+    if (pConnection->bIndentifyNeeded)
+    {
+        socket_timer_start(pSocket, DRV_SOCKET_TIMER_IDENTIFY + nConnectionIndex, pdMS_TO_TICKS(DRV_SOCKET_IDENTIFY_TIME_MS));
+    }
+    else
+    {
+        socket_timer_stop(pSocket, DRV_SOCKET_TIMER_IDENTIFY + nConnectionIndex);
+    }
+    socket_timer_stop(pSocket, DRV_SOCKET_TIMER_PING + nConnectionIndex);
+    pConnection->nPingCount = 0;
     pSocket->nPingTicks = 0;
-    pSocket->nPingCount = 0;
+    pSocket->nTimeoutSendEnable = 0;
+    socket_connection_state_mirror(pSocket, nConnectionIndex);
 }
 
 void socket_add_to_list(drv_socket_t* pSocket)
 {
+    taskENTER_CRITICAL(&socket_list_lock);
     nSocketCountTotal++;
     if (nSocketListCount < DRV_SOCKET_COUNT_MAX)
     {
         pSocketList[nSocketListCount++] = pSocket;
     }
-    
+    taskEXIT_CRITICAL(&socket_list_lock);
 }
 
 void socket_del_from_list(drv_socket_t* pSocket)
 {
+    taskENTER_CRITICAL(&socket_list_lock);
     nSocketCountTotal--;
     for (int index = 0; index < nSocketListCount; index++)
     {
@@ -1557,6 +4270,7 @@ void socket_del_from_list(drv_socket_t* pSocket)
             nSocketListCount--;
         }
     }
+    taskEXIT_CRITICAL(&socket_list_lock);
 }
 
 void socket_runtime_init(drv_socket_t* pSocket)
@@ -1565,6 +4279,49 @@ void socket_runtime_init(drv_socket_t* pSocket)
     strcpy(pSocket->pRuntime->cAdapterInterfaceIP,"0.0.0.0");
     pSocket->pRuntime->pLastUsedHostIP = pSocket->cHostIP;
     pSocket->pRuntime->bBroadcastRxTx = false;
+    bzero((void*)pSocket->pRuntime->connection, sizeof(pSocket->pRuntime->connection));
+    pSocket->pRuntime->wakeup.nSocket = -1;
+    pSocket->pRuntime->wakeup.bPending = false;
+    pSocket->pRuntime->pWakeup = NULL;
+    pSocket->pRuntime->bEventsValid = false;
+    pSocket->pRuntime->nSendNext = 0;
+    socket_timer_init(pSocket);
+    socket_reconnect_time_reset(pSocket);
+    pSocket->pRuntime->connect.nSocket = -1;
+    pSocket->pRuntime->connect.bInProgress = false;
+    pSocket->pRuntime->connect.nTimer = DRV_SOCKET_TIMER_CONNECT;
+    pSocket->pRuntime->failover.nSocket = -1;
+    pSocket->pRuntime->failover.bInProgress = false;
+    pSocket->pRuntime->failover.nTimer = DRV_SOCKET_TIMER_CONNECT + 1;
+    pSocket->pRuntime->nFailoverInterfaceIndex = -1;
+    pSocket->pRuntime->nFailoverSocket = -1;
+    pSocket->pRuntime->multipath.nSocket = -1;
+    pSocket->pRuntime->multipath.bInProgress = false;
+    pSocket->pRuntime->multipath.nTimer = DRV_SOCKET_TIMER_CONNECT + 2;
+    pSocket->pRuntime->nMultipathIndex = -1;
+    pSocket->pRuntime->nMultipathActiveIndex = 0;
+    pSocket->pRuntime->u32FrameSession = 0;
+    pSocket->pRuntime->u32FrameSendSeq = 0;
+    pSocket->pRuntime->u32FrameRecvSeq = 0;
+    pSocket->pRuntime->nFrameSendLength = -1;
+    pSocket->pRuntime->u8FrameSendFlags = 0;
+    pSocket->pRuntime->bHostIPFallback = false;
+    pSocket->pRuntime->bDnsWait = false;
+    pSocket->pRuntime->u16HostPort = pSocket->u16Port;
+    for (int nIndex = 0; nIndex < DRV_SOCKET_CONNECT_RACE_COUNT; nIndex++)
+    {
+        pSocket->pRuntime->race[nIndex].nSocket = -1;
+        pSocket->pRuntime->race[nIndex].bInProgress = false;
+        pSocket->pRuntime->race[nIndex].nTimer = DRV_SOCKET_TIMER_CONNECT + 3 + nIndex;
+    }
+    pSocket->pRuntime->bRacing = false;
+    pSocket->pRuntime->nEndpointWinner = -1;
+    pSocket->pRuntime->nEndpointIndex = -1;
+    socket_last_good_load(pSocket);
+    pSocket->pRuntime->abInterfaceConnected[DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT] = false;
+    pSocket->pRuntime->abInterfaceConnected[DRV_SOCKET_ADAPTER_INTERFACE_BACKUP] = false;
+    pSocket->pRuntime->u32InterfaceEventCount = u32InterfaceEventCount - 1;     /* refresh on the first loop */
+    socket_timer_start(pSocket, DRV_SOCKET_TIMER_INTERFACE_REFRESH, 0);
     bzero((void*)&pSocket->pRuntime->host_addr_main, sizeof(pSocket->pRuntime->host_addr_main));
     bzero((void*)&pSocket->pRuntime->host_addr_recv, sizeof(pSocket->pRuntime->host_addr_recv));
     bzero((void*)&pSocket->pRuntime->host_addr_send, sizeof(pSocket->pRuntime->host_addr_send));
@@ -1575,6 +4332,7 @@ void socket_runtime_init(drv_socket_t* pSocket)
     #else
     pSocket->pRuntime->adapter_if = ESP_IF_ETH; //set as not selected if
     #endif
+    pSocket->pRuntime->multipath_if = pSocket->pRuntime->adapter_if;    //not selected until the secondary connects
 }
 
 void socket_force_disconnect(drv_socket_t* pSocket)
@@ -1596,6 +4354,10 @@ void socket_force_disconnect(drv_socket_t* pSocket)
             pSocket->nSocketIndexPrimer[nIndex] = -1;
         }
     }
+    socket_connect_attempt_close(pSocket, &pSocket->pRuntime->connect);
+    socket_failover_stop(pSocket);
+    socket_multipath_stop(pSocket);
+    socket_race_stop(pSocket);
 }
 
 bool socket_check_interface_connected(esp_interface_t interface)
@@ -1627,9 +4389,154 @@ bool socket_check_interface_connected(esp_interface_t interface)
     }
 }
 
+/* switch a live connection to another interface - break-before-make or make-before-break (client sockets) */
+void socket_adapter_if_switch(drv_socket_t* pSocket, int nInterfaceIndex)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+
+    if ((pRuntime->nMultipathIndex >= 0) && (pRuntime->multipath_if == pSocket->adapter_interface[nInterfaceIndex]))
+    {
+        /* multipath - the secondary connection already runs on the target interface, swap the roles */
+        ESP_LOGW(TAG, "Socket %s multipath primary and secondary swapped", pSocket->cName);
+        struct sockaddr_storage bind_addr = pRuntime->adapterif_addr;
+        char cBindIP[sizeof(pRuntime->cAdapterInterfaceIP)];
+        strcpy(cBindIP, pRuntime->cAdapterInterfaceIP);
+
+        int nPrimaryIndex = socket_client_connection_index(pSocket);
+        pRuntime->multipath_if = pRuntime->adapter_if;
+        pRuntime->adapter_if = pSocket->adapter_interface[nInterfaceIndex];
+        pRuntime->adapterif_addr = pRuntime->multipath.bind_addr;
+        strcpy(pRuntime->cAdapterInterfaceIP, pRuntime->multipath.cBindIP);
+        pRuntime->multipath.bind_addr = bind_addr;
+        strcpy(pRuntime->multipath.cBindIP, cBindIP);
+        pRuntime->nMultipathActiveIndex = pRuntime->nMultipathIndex;
+        pRuntime->nMultipathIndex = nPrimaryIndex;
+        return;
+    }
+
+    if (pSocket->bFailoverMakeBeforeBreak && (pSocket->bServerType == false) && pSocket->bConnected && (socket_multipath_framed(pSocket) == false))
+    {
+        if ((pRuntime->nFailoverInterfaceIndex < 0) && (socket_timer_running(pSocket, DRV_SOCKET_TIMER_FAILOVER_RETRY) == false))
+        {
+            ESP_LOGW(TAG, "Socket %s start make-before-break failover to interface %d", pSocket->cName, pSocket->adapter_interface[nInterfaceIndex]);
+            pRuntime->nFailoverInterfaceIndex = nInterfaceIndex;
+        }
+        return;     /* current interface kept until the new connection is established */
+    }
+
+    pRuntime->adapter_if = pSocket->adapter_interface[nInterfaceIndex];
+
+    ESP_LOGI (TAG, "setting pSocket -> bDisconnectRequest = true" ) ;
+    pSocket->bDisconnectRequest = true;
+}
+
+static void socket_interface_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    (void)arg;
+    (void)event_base;
+    (void)event_id;
+    (void)event_data;
+
+    u32InterfaceEventCount++;
+
+    /* sockets refresh the cached interface state on the next loop */
+    socket_list_wakeup(NULL);
+}
+
+/* subscribe to the interface events (fails until the default event loop is created) */
+/* handler registered once for all socket tasks - all bases or none, retried from socket_interface_state_update */
+void socket_interface_events_register(void)
+{
+    bool bClaimed = false;
+
+    taskENTER_CRITICAL(&socket_events_lock);
+    if ((bInterfaceEventsRegistered == false) && (bInterfaceEventsRegistering == false))
+    {
+        bInterfaceEventsRegistering = true;
+        bClaimed = true;
+    }
+    taskEXIT_CRITICAL(&socket_events_lock);
+    if (bClaimed == false) return;
+
+    esp_err_t err = esp_event_handler_instance_register(IP_EVENT, ESP_EVENT_ANY_ID, &socket_interface_event_handler, NULL, &interface_event_instance_ip);
+    #if CONFIG_DRV_WIFI_USE
+    if (err == ESP_OK)
+    {
+        err = esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &socket_interface_event_handler, NULL, &interface_event_instance_wifi);
+        if (err != ESP_OK)
+        {
+            esp_event_handler_instance_unregister(IP_EVENT, ESP_EVENT_ANY_ID, interface_event_instance_ip);
+        }
+    }
+    #endif
+    #if CONFIG_DRV_ETH_USE
+    if (err == ESP_OK)
+    {
+        err = esp_event_handler_instance_register(ETH_EVENT, ESP_EVENT_ANY_ID, &socket_interface_event_handler, NULL, &interface_event_instance_eth);
+        if (err != ESP_OK)
+        {
+            esp_event_handler_instance_unregister(IP_EVENT, ESP_EVENT_ANY_ID, interface_event_instance_ip);
+            #if CONFIG_DRV_WIFI_USE
+            esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, interface_event_instance_wifi);
+            #endif
+        }
+    }
+    #endif
+
+    taskENTER_CRITICAL(&socket_events_lock);
+    bInterfaceEventsRegistered = (err == ESP_OK);
+    bInterfaceEventsRegistering = false;
+    taskEXIT_CRITICAL(&socket_events_lock);
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGD(TAG, "Interface events not registered (%s) - poll interface state", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGI(TAG, "Interface events registered");
+}
+
+/* refresh the cached state of the socket interfaces on events, periodically or every loop if events not available */
+void socket_interface_state_update(drv_socket_t* pSocket)
+{
+    drv_socket_runtime_t* pRuntime = pSocket->pRuntime;
+    uint32_t u32EventCount = u32InterfaceEventCount;
+
+    if (bInterfaceEventsRegistered)
+    {
+        if (pRuntime->u32InterfaceEventCount != u32EventCount)
+        {
+            pRuntime->u32InterfaceEventCount = u32EventCount;
+            socket_timer_start(pSocket, DRV_SOCKET_TIMER_INTERFACE_REFRESH, pdMS_TO_TICKS(DRV_SOCKET_INTERFACE_SETTLE_TIME_MS));
+        }
+        else
+        if (socket_timer_expired(pSocket, DRV_SOCKET_TIMER_INTERFACE_REFRESH))
+        {
+            socket_timer_start(pSocket, DRV_SOCKET_TIMER_INTERFACE_REFRESH, pdMS_TO_TICKS(DRV_SOCKET_INTERFACE_REFRESH_TIME_MS));
+        }
+        else
+        {
+            return;     /* cached state valid */
+        }
+    }
+    else
+    if (socket_timer_expired(pSocket, DRV_SOCKET_TIMER_INTERFACE_REFRESH))
+    {
+        /* polled every loop until the events are registered */
+        socket_timer_start(pSocket, DRV_SOCKET_TIMER_INTERFACE_REFRESH, pdMS_TO_TICKS(DRV_SOCKET_INTERFACE_REFRESH_TIME_MS));
+        socket_interface_events_register();
+    }
+
+    pRuntime->abInterfaceConnected[DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT] = socket_check_interface_connected(pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT]);
+    pRuntime->abInterfaceConnected[DRV_SOCKET_ADAPTER_INTERFACE_BACKUP] = socket_check_interface_connected(pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_BACKUP]);
+}
+
 bool socket_select_adapter_if(drv_socket_t* pSocket)
 {
 	bool bSelectedValidInterface = false;
+    bool* abInterfaceConnected = pSocket->pRuntime->abInterfaceConnected;
+
+    socket_interface_state_update(pSocket);
 
 	#if CONFIG_DRV_ETH_USE
     if (pSocket->pRuntime->adapter_if >= (ESP_IF_ETH + drv_eth_get_netif_count()))  //not selected valid if
@@ -1638,29 +4545,31 @@ bool socket_select_adapter_if(drv_socket_t* pSocket)
 	#endif
     {
         ESP_LOGE(TAG, "Socket %s not selected valid if", pSocket->cName);
-        pSocket->pRuntime->adapter_if = pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT];
+        int nInterfaceIndex = DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT;
+        if (pSocket->pRuntime->bLastGoodValid && abInterfaceConnected[pSocket->pRuntime->lastGood.u8InterfaceIndex])
+        {
+            nInterfaceIndex = pSocket->pRuntime->lastGood.u8InterfaceIndex;     /* interface of the last successful connect */
+        }
+        pSocket->pRuntime->adapter_if = pSocket->adapter_interface[nInterfaceIndex];
         pSocket->bDisconnectRequest = true;
     }
     else if (pSocket->pRuntime->adapter_if == pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT])
     {
-        if (socket_check_interface_connected(pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT]))
+        if (abInterfaceConnected[DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT])
         {
             bSelectedValidInterface = true;
             if (pSocket->bPriorityBackupAdapterInterface == DRV_SOCKET_PRIORITY_INTERFACE_BACKUP)
             {
-                if (socket_check_interface_connected(pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_BACKUP]))
+                if (abInterfaceConnected[DRV_SOCKET_ADAPTER_INTERFACE_BACKUP])
                 {
                     ESP_LOGW(TAG, "Socket %s switch to INTERFACE DEFAULT -> BACKUP", pSocket->cName);
-                    pSocket->pRuntime->adapter_if = pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_BACKUP];
-
-                    ESP_LOGI (TAG, "setting pSocket -> bDisconnectRequest = true" ) ;
-                    pSocket->bDisconnectRequest = true;
+                    socket_adapter_if_switch(pSocket, DRV_SOCKET_ADAPTER_INTERFACE_BACKUP);
                 } 
             }
         }
         else
         {
-            if (socket_check_interface_connected(pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_BACKUP]))
+            if (abInterfaceConnected[DRV_SOCKET_ADAPTER_INTERFACE_BACKUP])
             {
                 ESP_LOGW(TAG, "Socket %s switch to INTERFACE DEFAULT -> BACKUP", pSocket->cName);
                 pSocket->pRuntime->adapter_if = pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_BACKUP];
@@ -1671,22 +4580,21 @@ bool socket_select_adapter_if(drv_socket_t* pSocket)
     }
     else if (pSocket->pRuntime->adapter_if == pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_BACKUP])
     {
-        if (socket_check_interface_connected(pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_BACKUP]))
+        if (abInterfaceConnected[DRV_SOCKET_ADAPTER_INTERFACE_BACKUP])
         {
             bSelectedValidInterface = true;
             if (pSocket->bPriorityBackupAdapterInterface == DRV_SOCKET_PRIORITY_INTERFACE_DEFAULT)
             {
-                if (socket_check_interface_connected(pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT]))
+                if (abInterfaceConnected[DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT])
                 {
                     ESP_LOGW(TAG, "Socket %s switch to INTERFACE BACKUP -> DEFAULT", pSocket->cName);
-                    pSocket->pRuntime->adapter_if = pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT];
-                    pSocket->bDisconnectRequest = true;
+                    socket_adapter_if_switch(pSocket, DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT);
                 }
             }
         }
         else
         {
-            if (socket_check_interface_connected(pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT]))
+            if (abInterfaceConnected[DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT])
             {
                 ESP_LOGW(TAG, "Socket %s switch to INTERFACE BACKUP -> DEFAULT", pSocket->cName);
                 pSocket->pRuntime->adapter_if = pSocket->adapter_interface[DRV_SOCKET_ADAPTER_INTERFACE_DEFAULT];
@@ -1704,249 +4612,705 @@ bool socket_select_adapter_if(drv_socket_t* pSocket)
 }
 
 
-static void socket_task(void* parameters)
+bool socket_wakeup_create(const char* pName, drv_socket_wakeup_t* pWakeup)
 {
-    drv_socket_t* pSocket = (drv_socket_t*)parameters;
+    int err;
+    struct sockaddr_in *wakeup_addr_ip4 = (struct sockaddr_in *)&pWakeup->addr;
+    socklen_t addr_len = sizeof(pWakeup->addr);
 
-    if (pSocket == NULL)
+    pWakeup->bPending = false;
+    bzero((void*)&pWakeup->addr, sizeof(pWakeup->addr));
+    wakeup_addr_ip4->sin_family = AF_INET;
+    wakeup_addr_ip4->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    wakeup_addr_ip4->sin_port = 0;  /* system assigned */
+
+    pWakeup->nSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (pWakeup->nSocket < 0)
     {
-        ESP_LOGE(TAG, "Unable to create socket NULL task");
-        vTaskDelete(NULL);
+        err = errno;
+        ESP_LOGE(TAG, "Unable to create wakeup socket %s: errno %d (%s)", pName, err, strerror(err));
+        return false;
+    }
+
+    if ((bind(pWakeup->nSocket, (struct sockaddr *)&pWakeup->addr, sizeof(pWakeup->addr)) != 0)
+     || (getsockname(pWakeup->nSocket, (struct sockaddr *)&pWakeup->addr, &addr_len) != 0))
+    {
+        err = errno;
+        ESP_LOGE(TAG, "Unable to bind wakeup socket %s %d to loopback: errno %d (%s)", pName, pWakeup->nSocket, err, strerror(err));
+        close(pWakeup->nSocket);
+        pWakeup->nSocket = -1;
+        return false;
+    }
+
+    int flags = fcntl(pWakeup->nSocket, F_GETFL, 0);
+    fcntl(pWakeup->nSocket, F_SETFL, flags | O_NONBLOCK);
+    ESP_LOGI(TAG, "Socket %s wakeup socket %d on port %d", pName, pWakeup->nSocket, ntohs(wakeup_addr_ip4->sin_port));
+    return true;
+}
+
+void socket_wakeup_close(drv_socket_wakeup_t* pWakeup)
+{
+    if (pWakeup->nSocket >= 0)
+    {
+        close(pWakeup->nSocket);
+        pWakeup->nSocket = -1;
+    }
+}
+
+void socket_wakeup_drain(drv_socket_wakeup_t* pWakeup)
+{
+    uint8_t au8Drain[8];
+
+    /* cleared first - a wakeup during drain is not lost */
+    taskENTER_CRITICAL(&socket_runtime_lock);
+    pWakeup->bPending = false;
+    taskEXIT_CRITICAL(&socket_runtime_lock);
+    while (recv(pWakeup->nSocket, au8Drain, sizeof(au8Drain), MSG_DONTWAIT) > 0)
+    {
+    }
+}
+
+bool socket_event_readable(drv_socket_t* pSocket, int nSocket)
+{
+    if (pSocket->pRuntime->bEventsValid == false) return true;     /* polling mode - always try */
+    return FD_ISSET(nSocket, &pSocket->pRuntime->rfds);
+}
+
+/* connection with a pending tail is retried only when its socket reports writable */
+bool socket_event_writable(drv_socket_t* pSocket, int nConnectionIndex)
+{
+    drv_socket_connection_t* pConnection = &pSocket->pRuntime->connection[nConnectionIndex];
+
+    if (pSocket->pRuntime->bEventsValid == false) return true;     /* polling mode - always try */
+    if (pConnection->nSendBufferOffset >= pConnection->nSendBufferLength) return true;
+    return FD_ISSET(pSocket->nSocketIndexPrimer[nConnectionIndex], &pSocket->pRuntime->wfds);
+}
+
+/* all connect attempts of the socket, returns their count */
+int socket_connect_attempts(drv_socket_t* pSocket, drv_socket_connect_t* apConnect[])
+{
+    int nConnectCount = 0;
+
+    apConnect[nConnectCount++] = &pSocket->pRuntime->connect;
+    apConnect[nConnectCount++] = &pSocket->pRuntime->failover;
+    apConnect[nConnectCount++] = &pSocket->pRuntime->multipath;
+    for (int nIndex = 0; nIndex < DRV_SOCKET_CONNECT_RACE_COUNT; nIndex++)
+    {
+        apConnect[nConnectCount++] = &pSocket->pRuntime->race[nIndex];
+    }
+    return nConnectCount;
+}
+
+/* ticks until the nearest time based action of the socket (bounded by the event wait time) */
+TickType_t socket_get_wait_ticks(drv_socket_t* pSocket)
+{
+    return socket_timer_wait_ticks(pSocket, pdMS_TO_TICKS(DRV_SOCKET_EVENT_WAIT_TIME_MS));
+}
+
+/* add the socket descriptors to the select sets, returns the max descriptor */
+int socket_prepare_events(drv_socket_t* pSocket, fd_set* rfds, fd_set* wfds)
+{
+    int nSocketMax = -1;
+
+    drv_socket_connect_t* apConnect[DRV_SOCKET_CONNECT_ATTEMPT_COUNT];
+    int nConnectCount = socket_connect_attempts(pSocket, apConnect);
+    for (int nIndex = 0; nIndex < nConnectCount; nIndex++)
+    {
+        if (apConnect[nIndex]->bInProgress == false) continue;
+
+        /* connect completion (or failure) reported as writable */
+        FD_SET(apConnect[nIndex]->nSocket, wfds);
+        if (nSocketMax < apConnect[nIndex]->nSocket) nSocketMax = apConnect[nIndex]->nSocket;
+    }
+
+    if (pSocket->bConnected == false) return nSocketMax;
+
+    if (pSocket->bServerType && (pSocket->nSocketIndexServer >= 0))
+    {
+        FD_SET(pSocket->nSocketIndexServer, rfds);
+        if (nSocketMax < pSocket->nSocketIndexServer) nSocketMax = pSocket->nSocketIndexServer;
+    }
+
+    for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
+    {
+        int nSocket = pSocket->nSocketIndexPrimer[nIndex];
+        if (nSocket < 0) continue;
+
+        if (socket_recv_paused(pSocket, nIndex) == false)
+        {
+            FD_SET(nSocket, rfds);
+        }
+        if (socket_send_pending(pSocket, nIndex))
+        {
+            FD_SET(nSocket, wfds);
+        }
+        if (nSocketMax < nSocket) nSocketMax = nSocket;
+    }
+    return nSocketMax;
+}
+
+/* block until socket activity, wakeup request or the nearest time based action of any of the sockets */
+void socket_wait_events(drv_socket_wakeup_t* pWakeup, drv_socket_t* apSocket[], int nSocketCount)
+{
+    fd_set rfds;
+    fd_set wfds;
+
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    FD_SET(pWakeup->nSocket, &rfds);
+
+    int nSocketMax = pWakeup->nSocket;
+    TickType_t nWaitTicks = pdMS_TO_TICKS(DRV_SOCKET_EVENT_WAIT_TIME_MS);
+
+    for (int nIndex = 0; nIndex < nSocketCount; nIndex++)
+    {
+        drv_socket_t* pSocket = apSocket[nIndex];
+        if (pSocket->pRuntime == NULL) continue;
+
+        int nSocketMaxPrepared = socket_prepare_events(pSocket, &rfds, &wfds);
+        if (nSocketMax < nSocketMaxPrepared) nSocketMax = nSocketMaxPrepared;
+
+        TickType_t nWaitTicksSocket = socket_get_wait_ticks(pSocket);
+        if (nWaitTicks > nWaitTicksSocket) nWaitTicks = nWaitTicksSocket;
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = (nWaitTicks * portTICK_PERIOD_MS) / 1000;
+    timeout.tv_usec = ((nWaitTicks * portTICK_PERIOD_MS) % 1000) * 1000;
+
+    int ready = select(nSocketMax + 1, &rfds, &wfds, NULL, &timeout);
+    if (ready < 0)
+    {
+        int err = errno;
+        ESP_LOGE(TAG, "Task %s Error in select() function: errno %d (%s)", pcTaskGetName(NULL), err, strerror(err));
+        for (int nIndex = 0; nIndex < nSocketCount; nIndex++)
+        {
+            if (apSocket[nIndex]->pRuntime == NULL) continue;
+            apSocket[nIndex]->pRuntime->bEventsValid = false;     /* poll everything on the next loop */
+        }
+        vTaskDelay(nTaskRestTimeTicks);
+        return;
+    }
+
+    if ((ready > 0) && FD_ISSET(pWakeup->nSocket, &rfds))
+    {
+        socket_wakeup_drain(pWakeup);
+    }
+
+    for (int nIndex = 0; nIndex < nSocketCount; nIndex++)
+    {
+        drv_socket_runtime_t* pRuntime = apSocket[nIndex]->pRuntime;
+        if (pRuntime == NULL) continue;
+        pRuntime->rfds = rfds;
+        pRuntime->wfds = wfds;
+        pRuntime->bEventsValid = true;
     }
+}
+
+void socket_task_stack_check(int64_t* print_timer, bool* stack_was_ok)
+{
+    #define DBG_TASK_STACK_WARN_MIN     128
+    #define DBG_TASK_STACK_WARN_HIGH    768
+    #define PRINT_TIMEOUT_US            (5000 * 1000)
+    int64_t current_timer = esp_timer_get_time();
+    size_t stack = uxTaskGetStackHighWaterMark(NULL);
+
+    if ((stack < DBG_TASK_STACK_WARN_MIN) || (stack > DBG_TASK_STACK_WARN_HIGH))
+    {
+        if (*stack_was_ok)
+        {
+            *stack_was_ok = false;
+            *print_timer = current_timer - PRINT_TIMEOUT_US;
+        }
+        if ((current_timer - *print_timer) >= PRINT_TIMEOUT_US)
+        {
+            ESP_LOGW(TAG, "Task %s stack:%u", pcTaskGetName(NULL), (unsigned)stack);    
+            *print_timer = current_timer;
+        }
+    } 
+    else
+    {
+        if (*stack_was_ok == false)
+        {
+            *stack_was_ok = true;
+            *print_timer = current_timer - PRINT_TIMEOUT_US;
+        }
+        if ((current_timer - *print_timer) >= PRINT_TIMEOUT_US)
+        {
+            ESP_LOGD(TAG, "Task %s stack:%u", pcTaskGetName(NULL), (unsigned)stack);    
+            *print_timer = current_timer;
+        }
+    }    
+}
 
+/* allocate and initialize the runtime of the socket - called from the serving task */
+bool socket_task_init(drv_socket_t* pSocket, drv_socket_wakeup_t* pWakeup)
+{
     drv_socket_runtime_t* pSocketRuntime = malloc(sizeof(drv_socket_runtime_t));
 
     if (pSocketRuntime == NULL)
     {
         ESP_LOGE(TAG, "Unable to allocate memory for runtime variables of socket %s", pSocket->cName);
-        pSocket->pTask = NULL;
-        vTaskDelete(NULL);
+        return false;
+    }
+
+    pSocketRuntime->pRecvBuffer = malloc(MAX_TCP_READ_SIZE);
+
+    if (pSocketRuntime->pRecvBuffer == NULL)
+    {
+        ESP_LOGE(TAG, "Unable to allocate %d bytes read buffer of socket %s", MAX_TCP_READ_SIZE, pSocket->cName);
+        free(pSocketRuntime);
+        return false;
     }
 
-    pSocket->pRuntime = pSocketRuntime;
+    pSocketRuntime->pWakeup = NULL;
+    socket_runtime_attach(pSocket, pSocketRuntime);
 
     socket_runtime_init(pSocket);
+
+    pSocketRuntime->pAckQueue = NULL;
+    if ((pSocket->onSendAcked != NULL) && (pSocket->protocol_type == DRV_SOCKET_SOCK_STREAM))
+    {
+        pSocketRuntime->pAckQueue = xQueueCreate(DRV_SOCKET_ACK_MARK_COUNT * DRV_SOCKET_SERVER_MAX_CLIENTS, sizeof(drv_socket_ack_request_t));
+        if (pSocketRuntime->pAckQueue == NULL)
+        {
+            ESP_LOGE(TAG, "Unable to allocate send marker queue of socket %s", pSocket->cName);
+        }
+    }
+
+    if (pWakeup != NULL)
+    {
+        /* served by a reactor task - use its wakeup socket */
+        pSocketRuntime->pWakeup = pWakeup;
+    }
+    else
+    if (pSocket->bEventDrivenMode)
+    {
+        if (socket_wakeup_create(pSocket->cName, &pSocketRuntime->wakeup))
+        {
+            pSocketRuntime->pWakeup = &pSocketRuntime->wakeup;
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Socket %s event driven mode not available - use polling", pSocket->cName);
+        }
+    }
+
+    socket_interface_events_register();
     socket_force_disconnect(pSocket);
+    socket_connection_list_init(pSocket);
+
+    if (pSocket->bLatencyStats && (pSocket->pLatency == NULL))
+    {
+        pSocket->pLatency = calloc(DRV_SOCKET_SERVER_MAX_CLIENTS, sizeof(drv_socket_latency_t));
+        if (pSocket->pLatency == NULL)
+        {
+            ESP_LOGE(TAG, "Unable to allocate latency histograms of socket %s", pSocket->cName);
+        }
+    }
 
     pSocket->nTaskLoopCounter = 0;
+    socket_stats_reset(pSocket);
     pSocket->bActiveTask = true;
     pSocket->bDisconnectRequest = false;
     pSocket->bConnected = false;
 
     socket_add_to_list(pSocket);
+    return true;
+}
 
-    int64_t print_timer = esp_timer_get_time();
-    bool stack_was_ok = true;
-  
-    while(pSocket->bActiveTask)
+void socket_task_deinit(drv_socket_t* pSocket)
+{
+    drv_socket_runtime_t* pSocketRuntime = pSocket->pRuntime;
+
+    /* open connections closed through the connection list - pending markers failed, onConnectionClose called */
+    socket_multipath_stop(pSocket);
+    for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
     {
-        bool bSelectedValidInterface = socket_select_adapter_if(pSocket);
-        
+        socket_disconnect_connection(pSocket, nIndex);
+    }
+    socket_force_disconnect(pSocket);
+    socket_del_from_list(pSocket);
+    socket_runtime_release(pSocket, pSocketRuntime);    /* not used by other tasks from here */
+    socket_wakeup_close(&pSocketRuntime->wakeup);
+    if (pSocketRuntime->pAckQueue != NULL)
+    {
+        drv_socket_ack_request_t request;
+        while (xQueueReceive(pSocketRuntime->pAckQueue, &request, 0) == pdTRUE)
+        {
+            pSocket->onSendAcked(request.nConnectionId, request.u32Marker, false);
+        }
+        vQueueDelete(pSocketRuntime->pAckQueue);
+    }
+    for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
+    {
+        free(pSocketRuntime->connection[nIndex].pSendBuffer);
+        free(pSocketRuntime->connection[nIndex].pFrameBuffer);
+    }
+    free(pSocketRuntime->pRecvBuffer);
+    free(pSocketRuntime);
+}
+
+/* one pass of the socket state machine - connect, receive, send, disconnect as needed (never sleeps) */
+void socket_task_loop(drv_socket_t* pSocket)
+{
+    if (pSocket->pRuntime == NULL) return;
+
+    int64_t nLoopStartUs = esp_timer_get_time();
+
+    socket_timer_process(pSocket);
+    socket_ack_periodic(pSocket);
+
+    bool bSelectedValidInterface = socket_select_adapter_if(pSocket);
+    
 
 
-        /* socket disconnect request execute */
-        if (pSocket->bDisconnectRequest)
+    /* socket disconnect request execute */
+    if (pSocket->bDisconnectRequest)
+    {
+        if (pSocket->bConnected)        /* added to disconnect sockets only if connected */
         {
-            if (pSocket->bConnected)        /* added to disconnect sockets only if connected */
+            //if ((pSocket->nSocketIndexPrimer >= 0) || (pSocket->nSocketIndexServer >= 0))
+            if ((pSocket->nSocketConnectionsCount > 0) || (pSocket->nSocketIndexServer >= 0))
             {
-                //if ((pSocket->nSocketIndexPrimer >= 0) || (pSocket->nSocketIndexServer >= 0))
-                if ((pSocket->nSocketConnectionsCount > 0) || (pSocket->nSocketIndexServer >= 0))
-                {
-                    pSocket->bDisconnectRequest = false;
-                    socket_disconnect(pSocket);
-                }
-                else
-                {
-                    ESP_LOGW(TAG, "socket %s: Skip Disconnect Request - Connected but no connections", pSocket->cName);
-                    pSocket->bDisconnectRequest = false;    /* socket not connected - skip disconnect */
-
-                }
+                pSocket->bDisconnectRequest = false;
+                socket_disconnect(pSocket);
             }
             else
             {
-                ESP_LOGW(TAG, "socket %s: Skip Disconnect Request - Not Connected", pSocket->cName);
+                ESP_LOGW(TAG, "socket %s: Skip Disconnect Request - Connected but no connections", pSocket->cName);
                 pSocket->bDisconnectRequest = false;    /* socket not connected - skip disconnect */
+
             }
         }
+        else
+        if ((pSocket->pRuntime->connect.nSocket >= 0) || pSocket->pRuntime->bRacing)
+        {
+            pSocket->bDisconnectRequest = false;
+            socket_connect_attempt_close(pSocket, &pSocket->pRuntime->connect);  /* abandon pending connect (interface switch or deny) */
+            socket_race_stop(pSocket);
+        }
+        else
+        {
+            ESP_LOGW(TAG, "socket %s: Skip Disconnect Request - Not Connected", pSocket->cName);
+            pSocket->bDisconnectRequest = false;    /* socket not connected - skip disconnect */
+        }
+    }
 
-        /* socket must be disconnected */
-        if (pSocket->pRuntime != NULL)
+    /* socket must be disconnected */
+    if (pSocket->pRuntime != NULL)
+    {
+        if (pSocket->bConnectDeny == false)
         {
-            if (pSocket->bConnectDeny == false)
+            if (pSocket->pRuntime->adapter_if == ESP_IF_ETH)//to do fix for more than one eth interface
             {
-                if (pSocket->pRuntime->adapter_if == ESP_IF_ETH)//to do fix for more than one eth interface
+                if (pSocket->bConnectDenyETH)
                 {
-                    if (pSocket->bConnectDenyETH)
-                    {
-                        pSocket->bConnectDeny = true;
-                    }
+                    pSocket->bConnectDeny = true;
                 }
-                else if (pSocket->pRuntime->adapter_if == ESP_IF_WIFI_STA)
+            }
+            else if (pSocket->pRuntime->adapter_if == ESP_IF_WIFI_STA)
+            {
+                 if (pSocket->bConnectDenySTA)
                 {
-                     if (pSocket->bConnectDenySTA)
-                    {
-                        pSocket->bConnectDeny = true;
-                    }
+                    pSocket->bConnectDeny = true;
                 }
-                else if (pSocket->pRuntime->adapter_if == ESP_IF_WIFI_AP)
+            }
+            else if (pSocket->pRuntime->adapter_if == ESP_IF_WIFI_AP)
+            {
+                if (pSocket->bConnectDenyAP)
                 {
-                    if (pSocket->bConnectDenyAP)
-                    {
-                        pSocket->bConnectDeny = true;
-                    }
+                    pSocket->bConnectDeny = true;
                 }
             }
         }
+    }
 
-        if (pSocket->bConnectDeny)
+    if (pSocket->bConnectDeny)
+    {
+        pSocket->bDisconnectRequest = true;
+    }
+    else 
+    /* socket is connected */
+    if (pSocket->bConnected)
+    {
+        /* Receive pause and send throttle state */
+        socket_watermark_periodic(pSocket);
+        socket_latency_periodic(pSocket);
+        /* multipath frames left in the frame buffers (receive resumed or the other connection caught up) */
+        if (socket_multipath_framed(pSocket))
         {
-            pSocket->bDisconnectRequest = true;
+            socket_multipath_deliver(pSocket);
         }
-        else 
-        /* socket is connected */
-        if (pSocket->bConnected)
+        /* Receive Data from all connections */
+        for (int nIndex = 0; nIndex < DRV_SOCKET_SERVER_MAX_CLIENTS; nIndex++)
         {
-            /* Data from/to all connections */
-            for (int nIndex = 0; nIndex < pSocket->nSocketConnectionsCount; nIndex++)
+            if (pSocket->nSocketIndexPrimer[nIndex] < 0) continue;     /* free slot */
+            if (socket_recv_paused(pSocket, nIndex)) continue;          /* consumer lags */
+            if (socket_event_readable(pSocket, pSocket->nSocketIndexPrimer[nIndex]))
             {
-                /* Receive Data */
                 socket_recv(pSocket, nIndex);
-                /* Send Data */
-                socket_send(pSocket, nIndex);
             }
-            /* check for incoming connections */
-            if (pSocket->bServerType)
+        }
+        /* Send Data to all connections */
+        socket_send_schedule(pSocket);
+        /* make-before-break failover in progress */
+        if (pSocket->pRuntime->nFailoverInterfaceIndex >= 0)
+        {
+            socket_failover_periodic(pSocket);
+        }
+        /* secondary connection and active connection selection */
+        if (socket_multipath_framed(pSocket) && pSocket->bConnected)
+        {
+            socket_multipath_periodic(pSocket);
+        }
+        /* check for incoming connections */
+        if (pSocket->bServerType && (pSocket->nSocketIndexServer >= 0))
+        {
+            if (socket_event_readable(pSocket, pSocket->nSocketIndexServer))
             {
                 socket_connect_server_periodic(pSocket);
             }
-
-            //ESP_LOGI(TAG, "socket %s %d: Loop Connected", pSocket->cName, nSocketClient);
         }
-        else
-        if (bSelectedValidInterface)
-        {
-            /* start connection from beginning */
-            //socket_disconnect(pSocket);
 
-            /* need to create socket (server for server or primer for client) */
-            if (((pSocket->bServerType == true) && (pSocket->nSocketIndexServer < 0)) 
-            // || ((pSocket->bServerType == false) && (pSocket->nSocketIndexPrimer[0] < 0)))
-            || ((pSocket->bServerType == false) && (pSocket->nSocketConnectionsCount <= 0)))
+        //ESP_LOGI(TAG, "socket %s %d: Loop Connected", pSocket->cName, nSocketClient);
+    }
+    else
+    if ((pSocket->bServerType == false) && pSocket->pRuntime->connect.bInProgress)
+    {
+        /* client connect attempt pending */
+        socket_connect_client_check(pSocket, &pSocket->pRuntime->connect, bSelectedValidInterface && (pSocket->pRuntime->connect.adapter_if == pSocket->pRuntime->adapter_if));
+    }
+    else
+    if ((pSocket->bServerType == false) && pSocket->pRuntime->bRacing)
+    {
+        /* client endpoints connect race pending */
+        socket_race_periodic(pSocket, bSelectedValidInterface);
+    }
+    else
+    if (bSelectedValidInterface && socket_reconnect_time_elapsed(pSocket))
+    {
+        /* start connection from beginning */
+        //socket_disconnect(pSocket);
+
+        if (pSocket->bServerType)
+        {
+            /* need to create socket */
+            if (pSocket->nSocketIndexServer < 0)
             {
-                if (pSocket->bServerType)
-                {
-                    ESP_LOGW(TAG, "socket server %s %d: Try Create Socket", pSocket->cName, pSocket->nSocketIndexServer);
-                }
-                else
-                {
-                    ESP_LOGW(TAG, "socket client %s[0] %d: Try Create Socket", pSocket->cName, pSocket->nSocketIndexPrimer[0]);
-                }
+                ESP_LOGW(TAG, "socket server %s %d: Try Create Socket", pSocket->cName, pSocket->nSocketIndexServer);
                 /* Try Create Socket */
                 socket_strt(pSocket);
                 //pSocket->bConnected = false; - not needed
             }
             else
             /* socket is created but not connected */
-            if (((pSocket->bServerType == true) && (pSocket->nSocketIndexServer >= 0)) 
-            // || ((pSocket->bServerType == false) && (pSocket->nSocketIndexPrimer[0] >= 0)))
-            || ((pSocket->bServerType == false) && (pSocket->nSocketConnectionsCount > 0)))
             {
-                if (pSocket->bServerType)
-                {
-                    ESP_LOGW(TAG, "socket server %s %d: Try Connect Socket", pSocket->cName, pSocket->nSocketIndexServer);
-                }
-                else
-                {
-                    ESP_LOGW(TAG, "socket client %s[0] %d: Try Connect Socket", pSocket->cName, pSocket->nSocketIndexPrimer[0]);
-                }
+                ESP_LOGW(TAG, "socket server %s %d: Try Connect Socket", pSocket->cName, pSocket->nSocketIndexServer);
                 /* Try Connect Socket */
                 socket_prepare_ip_info(pSocket);
+                socket_connect_server(pSocket);
 
-                if (pSocket->bServerType)
-                {
-                    socket_connect_server(pSocket);
-                }
-                else /* Client socket type */
-                {
-                    socket_connect_client(pSocket);
-                }
-
-                if ((pSocket->bServerType == true) && (pSocket->nSocketIndexServer >= 0)) 
+                if (pSocket->nSocketIndexServer >= 0) 
                 {
+                    socket_reconnect_time_reset(pSocket);
                     pSocket->bConnected = true;
                     pSocket->bDisconnectRequest = false;
                 }
                 else
-                if (pSocket->nSocketConnectionsCount > 0)
-                //if (pSocket->nSocketIndexPrimer[0] > 0)
                 {
-                    
-                    pSocket->bConnected = true;
-                    pSocket->bDisconnectRequest = false;
+                    //pSocket->bConnected = false; - not needed
+                    socket_reconnect_time_start(pSocket);
                 }
-                else
+            }
+        }
+        else /* Client socket type */
+        if (socket_dns_host_ready(pSocket))     /* else wait for the background resolve of the url */
+        {
+            if (pSocket->nEndpointCount > 0)
+            {
+                socket_race_start(pSocket);
+                socket_race_periodic(pSocket, bSelectedValidInterface);
+            }
+            else
+            if (pSocket->pRuntime->connect.nSocket < 0)
+            {
+                ESP_LOGW(TAG, "socket client %s[0] %d: Try Create Socket", pSocket->cName, pSocket->pRuntime->connect.nSocket);
+                /* Try Create Socket */
+                socket_strt(pSocket);
+                if (pSocket->pRuntime->connect.nSocket < 0)
                 {
-                    //pSocket->bConnected = false; - not needed
-                    vTaskDelay(nReconnectTimeTicks); 
+                    socket_reconnect_time_start(pSocket);
                 }
             }
+            /* socket is created but not connected - start connecting in the same loop */
+            if (pSocket->pRuntime->connect.nSocket >= 0)
+            {
+                ESP_LOGW(TAG, "socket client %s[0] %d: Try Connect Socket", pSocket->cName, pSocket->pRuntime->connect.nSocket);
+                /* Try Connect Socket */
+                socket_prepare_ip_info(pSocket);
+                socket_connect_target(pSocket, &pSocket->pRuntime->connect);
+                socket_connect_client(pSocket, &pSocket->pRuntime->connect);
+            }
+        }
+    }
+    else
+    {
+        /* not connected or connecting */
+    }
+    pSocket->nTaskLoopCounter++;
+
+    uint32_t u32LoopTimeUs = (uint32_t)(esp_timer_get_time() - nLoopStartUs);
+    pSocket->stats.u32Loops++;
+    pSocket->stats.u64LoopTimeUs += u32LoopTimeUs;
+    if (pSocket->stats.u32LoopTimeMaxUs < u32LoopTimeUs)
+    {
+        pSocket->stats.u32LoopTimeMaxUs = u32LoopTimeUs;
+    }
+}
+
+static void socket_task(void* parameters)
+{
+    drv_socket_t* pSocket = (drv_socket_t*)parameters;
+
+    if (pSocket == NULL)
+    {
+        ESP_LOGE(TAG, "Unable to create socket NULL task");
+        vTaskDelete(NULL);
+    }
+
+    if (socket_task_init(pSocket, NULL) == false)
+    {
+        pSocket->pTask = NULL;
+        vTaskDelete(NULL);
+    }
+
+    int64_t print_timer = esp_timer_get_time();
+    bool stack_was_ok = true;
+  
+    while(pSocket->bActiveTask)
+    {
+        socket_task_loop(pSocket);
+
+        socket_task_stack_check(&print_timer, &stack_was_ok);
+
+        if (pSocket->pRuntime->pWakeup != NULL)
+        {
+            socket_wait_events(pSocket->pRuntime->pWakeup, &pSocket, 1);
         }
         else
         {
-            /* not connected or connecting */
+            vTaskDelay(nTaskRestTimeTicks);
         }
-        pSocket->nTaskLoopCounter++;
-        #define DBG_TASK_STACK_WARN_MIN     128
-        #define DBG_TASK_STACK_WARN_HIGH    768
-        #define PRINT_TIMEOUT_US            (5000 * 1000)
-        int64_t current_timer = esp_timer_get_time();
-        size_t stack = uxTaskGetStackHighWaterMark(NULL);
+    }
+    socket_task_deinit(pSocket);
+    pSocket->pTask = NULL;
+    vTaskDelete(NULL);
+}
+
+static void socket_reactor_task(void* parameters)
+{
+    drv_socket_reactor_t* pReactor = (drv_socket_reactor_t*)parameters;
+    drv_socket_t* apSocket[DRV_SOCKET_COUNT_MAX];
+    int nSocketCount;
+
+    int64_t print_timer = esp_timer_get_time();
+    bool stack_was_ok = true;
+
+    while(1)
+    {
+        /* snapshot of the attached sockets - attach may run from other tasks */
+        taskENTER_CRITICAL(&pReactor->lock);
+        nSocketCount = pReactor->nSocketCount;
+        memcpy(apSocket, pReactor->apSocket, sizeof(apSocket[0]) * nSocketCount);
+        taskEXIT_CRITICAL(&pReactor->lock);
 
-        if ((stack < DBG_TASK_STACK_WARN_MIN) || (stack > DBG_TASK_STACK_WARN_HIGH))
+        for (int nIndex = 0; nIndex < nSocketCount; nIndex++)
         {
-            if (stack_was_ok)
-            {
-                stack_was_ok = false;
-                print_timer = current_timer - PRINT_TIMEOUT_US;
-            }
-            if ((current_timer - print_timer) >= PRINT_TIMEOUT_US)
+            drv_socket_t* pSocket = apSocket[nIndex];
+
+            if (pSocket->pRuntime == NULL)
             {
-                ESP_LOGW(TAG, "Task %s stack:%d", pcTaskGetName(NULL), stack);    
-                print_timer = current_timer;
+                if (socket_task_init(pSocket, &pReactor->wakeup) == false)
+                {
+                    pSocket->bActiveTask = false;
+                }
             }
-        } 
-        else
-        {
-            if (stack_was_ok == false)
+
+            if (pSocket->bActiveTask)
             {
-                stack_was_ok = true;
-                print_timer = current_timer - PRINT_TIMEOUT_US;
+                socket_task_loop(pSocket);
             }
-            if ((current_timer - print_timer) >= PRINT_TIMEOUT_US)
+            else
             {
-                ESP_LOGD(TAG, "Task %s stack:%d", pcTaskGetName(NULL), stack);    
-                print_timer = current_timer;
+                /* socket stopped (or re-started) - release it from the reactor */
+                if (pSocket->pRuntime != NULL)
+                {
+                    socket_task_deinit(pSocket);
+                }
+                socket_reactor_detach(pReactor, pSocket);
+                pSocket->pTask = NULL;
             }
-        }    
+        }
 
-        vTaskDelay(nTaskRestTimeTicks);
+        socket_task_stack_check(&print_timer, &stack_was_ok);
+
+        /* re-read the count - sockets detached above must not be waited on */
+        taskENTER_CRITICAL(&pReactor->lock);
+        nSocketCount = pReactor->nSocketCount;
+        memcpy(apSocket, pReactor->apSocket, sizeof(apSocket[0]) * nSocketCount);
+        taskEXIT_CRITICAL(&pReactor->lock);
+
+        socket_wait_events(&pReactor->wakeup, apSocket, nSocketCount);
     }
-    socket_force_disconnect(pSocket);
-    socket_del_from_list(pSocket);
-    pSocket->pRuntime = NULL;
-    free(pSocketRuntime);
-    pSocket->pTask = NULL;
-    vTaskDelete(NULL);
+}
+
+void socket_reactor_detach(drv_socket_reactor_t* pReactor, drv_socket_t* pSocket)
+{
+    taskENTER_CRITICAL(&pReactor->lock);
+    for (int nIndex = 0; nIndex < pReactor->nSocketCount; nIndex++)
+    {
+        if (pReactor->apSocket[nIndex] == pSocket)
+        {
+            pReactor->nSocketCount--;
+            pReactor->apSocket[nIndex] = pReactor->apSocket[pReactor->nSocketCount];  /* order not relevant */
+            pReactor->apSocket[pReactor->nSocketCount] = NULL;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&pReactor->lock);
+}
+
+bool socket_reactor_start(drv_socket_reactor_t* pReactor, int nReactorIndex, int priority)
+{
+    char cTaskName[16];
+
+    sprintf(cTaskName, "socket_io_%d", nReactorIndex);
+    if (socket_wakeup_create(cTaskName, &pReactor->wakeup) == false)
+    {
+        return false;
+    }
+    ESP_LOGI(TAG, "Creating Task %s", cTaskName);
+    xTaskCreate(socket_reactor_task, cTaskName, DRV_SOCKET_REACTOR_STACK_SIZE, (void*)pReactor, priority, &pReactor->pTask);
+    if (pReactor->pTask == NULL)
+    {
+        socket_wakeup_close(&pReactor->wakeup);
+        return false;
+    }
+    return true;
 }
 
 /* Start / Re-start socket */
 esp_err_t drv_socket_task(drv_socket_t* pSocket, int priority)
 {
     if (pSocket == NULL) return ESP_FAIL;
-    do
+    /* stop the running task - it ends after its current loop */
+    pSocket->bActiveTask = false;
+    while (pSocket->pTask != NULL)
     {
-        pSocket->bActiveTask = false;
-    }while(pSocket->pTask != NULL);
+        drv_socket_wakeup(pSocket);
+        vTaskDelay(1);
+    }
     char* pTaskName = malloc(16);
     sprintf(pTaskName, "socket_%s",pSocket->cName);
     ESP_LOGI(TAG, "Creating Task %s", pTaskName);
@@ -1958,12 +5322,117 @@ esp_err_t drv_socket_task(drv_socket_t* pSocket, int priority)
     {
         priority = 5;       /* use default priority */
     }
-    xTaskCreate(socket_task, pTaskName, 2048 + 256 + 128, (void*)pSocket, priority, &pSocket->pTask);
+    xTaskCreate(socket_task, pTaskName, DRV_SOCKET_TASK_STACK_SIZE, (void*)pSocket, priority, &pSocket->pTask);
     free(pTaskName);
     if (pSocket->pTask == NULL) return ESP_FAIL;
     return ESP_OK;
 }
 
+/* Start / Re-start socket served by a shared reactor task (the least loaded one) */
+esp_err_t drv_socket_reactor_task(drv_socket_t* pSocket, int priority)
+{
+    if (pSocket == NULL) return ESP_FAIL;
+    /* stop the running task - it ends after its current loop */
+    pSocket->bActiveTask = false;
+    while (pSocket->pTask != NULL)
+    {
+        drv_socket_wakeup(pSocket);
+        vTaskDelay(1);
+    }
+
+    if (priority >= configMAX_PRIORITIES)
+    {
+        priority = configMAX_PRIORITIES - 1;
+    }
+    else if (priority < 0)
+    {
+        priority = 5;       /* use default priority */
+    }
+
+    /* reactors not started yet claimed under the lock - each created once with concurrent attach calls */
+    bool abStart[DRV_SOCKET_REACTOR_COUNT] = {false};
+    taskENTER_CRITICAL(&socket_reactor_start_lock);
+    for (int nIndex = 0; nIndex < DRV_SOCKET_REACTOR_COUNT; nIndex++)
+    {
+        if ((socket_reactor[nIndex].pTask == NULL) && (socket_reactor[nIndex].bStarting == false))
+        {
+            socket_reactor[nIndex].bStarting = true;
+            abStart[nIndex] = true;
+        }
+    }
+    taskEXIT_CRITICAL(&socket_reactor_start_lock);
+
+    for (int nIndex = 0; nIndex < DRV_SOCKET_REACTOR_COUNT; nIndex++)
+    {
+        if (abStart[nIndex] == false) continue;
+        if (socket_reactor_start(&socket_reactor[nIndex], nIndex, priority) == false)
+        {
+            ESP_LOGE(TAG, "Unable to start reactor %d for socket %s", nIndex, pSocket->cName);
+        }
+        taskENTER_CRITICAL(&socket_reactor_start_lock);
+        socket_reactor[nIndex].bStarting = false;
+        taskEXIT_CRITICAL(&socket_reactor_start_lock);
+    }
+
+    /* least loaded running reactor selected and attached under the lock - reactors started by other calls waited for */
+    drv_socket_reactor_t* pReactor = NULL;
+    esp_err_t eResult = ESP_FAIL;
+    bool bPending;
+    pSocket->bActiveTask = true;    /* runtime is initialized by the reactor task */
+    do
+    {
+        bPending = false;
+        taskENTER_CRITICAL(&socket_reactor_start_lock);
+        for (int nIndex = 0; nIndex < DRV_SOCKET_REACTOR_COUNT; nIndex++)
+        {
+            if (socket_reactor[nIndex].bStarting)
+            {
+                bPending = true;
+                continue;
+            }
+            if (socket_reactor[nIndex].pTask == NULL) continue;
+            if ((pReactor == NULL) || (pReactor->nSocketCount > socket_reactor[nIndex].nSocketCount))
+            {
+                pReactor = &socket_reactor[nIndex];
+            }
+        }
+        if (pReactor != NULL)
+        {
+            taskENTER_CRITICAL(&pReactor->lock);
+            if (pReactor->nSocketCount < DRV_SOCKET_COUNT_MAX)
+            {
+                pReactor->apSocket[pReactor->nSocketCount++] = pSocket;
+                pSocket->pTask = pReactor->pTask;
+                eResult = ESP_OK;
+            }
+            taskEXIT_CRITICAL(&pReactor->lock);
+        }
+        taskEXIT_CRITICAL(&socket_reactor_start_lock);
+        if ((pReactor == NULL) && bPending)
+        {
+            vTaskDelay(1);
+        }
+    }while((pReactor == NULL) && bPending);
+
+    if (pReactor == NULL)
+    {
+        pSocket->bActiveTask = false;
+        return ESP_FAIL;
+    }
+
+    if (eResult == ESP_OK)
+    {
+        ESP_LOGI(TAG, "Socket %s attached to reactor task %s", pSocket->cName, pcTaskGetName(pReactor->pTask));
+        socket_wakeup_send(&pReactor->wakeup);     /* runtime not yet created - wake the reactor directly */
+    }
+    else
+    {
+        pSocket->bActiveTask = false;
+        ESP_LOGE(TAG, "Socket %s not attached - reactor full", pSocket->cName);
+    }
+    return eResult;
+}
+
 void drv_socket_init(void)
 {
     
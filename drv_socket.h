@@ -25,6 +25,7 @@ extern "C"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/stream_buffer.h"
+#include "freertos/queue.h"
 #include "esp_err.h"
 #include "esp_interface.h"
 
@@ -42,10 +43,30 @@ extern "C"
 //#define DRV_SOCKET_DEFAULT_URL  "www.ivetell.com"
 //#define DRV_SOCKET_DEFAULT_IP   "84.40.115.3"
 #define DRV_SOCKET_SERVER_MAX_CLIENTS  CONFIG_DRV_SOCKET_SERVER_MAX_CLIENTS
+#define DRV_SOCKET_LATENCY_BUCKET_COUNT 96      /* log-linear: 4 buckets per power of two, 1 us .. 33 s */
+#define DRV_SOCKET_LATENCY_MARK_COUNT   8       /* timestamped stream offsets in flight per direction */
+#define DRV_SOCKET_ACK_MARK_COUNT       8       /* drv_socket_send_mark() markers awaiting the peer ack per connection */
+#define DRV_SOCKET_ENDPOINT_COUNT_MAX  CONFIG_DRV_SOCKET_ENDPOINT_COUNT_MAX
+#define DRV_SOCKET_CONNECT_RACE_COUNT  CONFIG_DRV_SOCKET_CONNECT_RACE_COUNT
+#define DRV_SOCKET_SEND_WEIGHT_MAX     16
+#define DRV_SOCKET_CONNECT_ATTEMPT_COUNT    (3 + DRV_SOCKET_CONNECT_RACE_COUNT)     /* connect, failover, multipath, race */
 
 /* *****************************************************************************
  * Constants and Macros Definitions
  **************************************************************************** */
+#define DRV_SOCKET_CONNECTION_ID_INVALID    0xFFFFFFFF
+#define DRV_SOCKET_CONNECTION_ID(generation, index)     ((((uint32_t)(generation)) << 16) | ((uint32_t)(index) & 0xFFFF))
+#define DRV_SOCKET_CONNECTION_INDEX(id)                 ((int)((id) & 0xFFFF))
+
+/* multipath frame on the wire (both directions): magic, flags, payload length (u16), sequence (u32), payload - big endian.
+   Each connection starts with a HELLO frame carrying the session id (u32) so the peer can group the connections of the
+   session. Sequences start at 0 per session, the receiver delivers them in order and drops the ones already delivered */
+#define DRV_SOCKET_FRAME_MAGIC              0xA5
+#define DRV_SOCKET_FRAME_HEADER_SIZE        8
+#define DRV_SOCKET_FRAME_FLAG_CRITICAL      0x01    /* sent on both connections (DRV_SOCKET_MULTIPATH_DUPLICATE) */
+#define DRV_SOCKET_FRAME_FLAG_HELLO         0x02    /* session id - not sequenced */
+#define DRV_SOCKET_FRAME_PAYLOAD_MAX        (CONFIG_DRV_SOCKET_MAX_TCP_SEND_SIZE - DRV_SOCKET_FRAME_HEADER_SIZE)    /* both directions */
+
 #if CONFIG_ESP_IF_WIFI_STA == 1
 #define DRV_SOCKET_IF_DEFAULT   ESP_IF_WIFI_STA
 #elif CONFIG_ESP_IF_WIFI_AP == 1
@@ -146,11 +167,115 @@ typedef enum
     DRV_SOCKET_PRIORITY_INTERFACE_BACKUP,
 }drv_socket_interface_priority_t;
 
+typedef enum
+{
+    DRV_SOCKET_MULTIPATH_OFF,
+    DRV_SOCKET_MULTIPATH_DUPLICATE,         /* frames on the primary connection, critical frames on both connections */
+    DRV_SOCKET_MULTIPATH_STEER_RTT,         /* frames on the connection with the lower tcp rtt */
+}drv_socket_multipath_t;
+
 
 
 /* *****************************************************************************
  * Type Definitions
  **************************************************************************** */
+typedef enum
+{
+    DRV_SOCKET_SEND_LANE_CONTROL,           /* pSendStreamBufferControl */
+    DRV_SOCKET_SEND_LANE_NORMAL,            /* pSendStreamBuffer */
+    DRV_SOCKET_SEND_LANE_BULK,              /* pSendStreamBufferBulk */
+    DRV_SOCKET_SEND_LANE_COUNT,
+}drv_socket_send_lane_t;
+
+/* counters updated by the serving task only, without locking - read and reset from other tasks are approximate */
+typedef struct
+{
+    uint64_t u64BytesIn;
+    uint64_t u64BytesOut;
+    uint32_t u32PacketsIn;          /* reads returning data */
+    uint32_t u32PacketsOut;         /* sends accepting data */
+    uint32_t u32RecvCalls;
+    uint32_t u32SendCalls;
+    uint32_t u32RecvAgain;          /* EAGAIN / EWOULDBLOCK */
+    uint32_t u32SendAgain;
+    uint32_t u32SendShort;          /* partial writes */
+    uint32_t u32PushFail;           /* receive stream push shorter than the data read */
+    uint32_t u32RecvDrops;          /* datagrams dropped - larger than the receive stream or the read buffer */
+    int64_t nStartTimeUs;           /* connection open or stats reset - rates base */
+}drv_socket_connection_stats_t;
+
+typedef struct
+{
+    uint32_t u32Connects;           /* client connections established / server connections accepted */
+    uint32_t u32ConnectFails;
+    uint32_t u32Reconnects;         /* reconnect delays started */
+    uint32_t u32AcceptRejects;      /* connections refused - no free slot */
+    uint32_t u32AllocFails;
+    uint32_t u32Loops;
+    uint32_t u32LoopTimeMaxUs;
+    uint64_t u64LoopTimeUs;         /* total - average per loop */
+    uint32_t u32FrameDups;          /* multipath frames received again on the other connection - dropped */
+    uint32_t u32FrameDupSkips;      /* critical frames not duplicated - the other connection still had a frame staged */
+    uint32_t u32FrameLost;          /* multipath frames skipped - lost with a closed connection */
+    int64_t nStartTimeUs;           /* stats reset - rates base */
+}drv_socket_stats_t;
+
+typedef struct
+{
+    uint32_t u32Offset;                     // stream byte count when the sample was taken
+    int64_t nTimeUs;
+}drv_socket_latency_mark_t;
+
+typedef struct
+{
+    drv_socket_latency_mark_t mark[DRV_SOCKET_LATENCY_MARK_COUNT];
+    uint8_t u8Head;                         // oldest mark
+    uint8_t u8Count;
+}drv_socket_latency_marks_t;
+
+typedef struct
+{
+    uint32_t au32Count[DRV_SOCKET_LATENCY_BUCKET_COUNT];
+    uint32_t u32Samples;
+    uint32_t u32MaxUs;
+}drv_socket_histogram_t;
+
+typedef struct
+{
+    drv_socket_histogram_t send;            /* queued in the send lanes until pulled for sending */
+    drv_socket_histogram_t recv;            /* pushed to the receive stream until pulled by the application */
+}drv_socket_latency_t;
+
+typedef struct
+{
+    uint32_t u32Samples;
+    uint32_t u32P50Us;
+    uint32_t u32P90Us;
+    uint32_t u32P99Us;
+    uint32_t u32MaxUs;
+}drv_socket_latency_summary_t;
+
+/* lwIP tcp_pcb snapshot (times in TCP_SLOW_INTERVAL resolution) */
+typedef struct
+{
+    int nState;                             /* enum tcp_state */
+    int nRttMs;                             /* smoothed rtt (-1 - not measured yet) */
+    int nRttVarMs;
+    int nRtoMs;
+    uint32_t u32Cwnd;
+    uint32_t u32Ssthresh;
+    uint32_t u32SendWindow;                 /* peer receive window */
+    uint32_t u32SendBufferFree;             /* snd_buf - space for send() */
+    uint32_t u32SendQueueLength;            /* pbufs queued (unsent + unacked) */
+    uint32_t u32UnsentBytes;
+    uint32_t u32UnackedBytes;               /* in flight */
+    uint32_t u32SendSeq;                    /* snd_lbb - sequence number after the last byte passed to send() */
+    uint32_t u32AckedSeq;                   /* lastack - sequence number acked by the peer */
+    uint16_t u16Mss;
+    uint8_t u8Retransmits;                  /* of the oldest unacked segment (reset on ack) */
+    uint8_t u8DupAcks;
+}drv_socket_tcp_info_t;
+
 typedef void (*drv_socket_on_connect_t)(int nConnectionIndex);
 typedef int (*drv_socket_on_receive_t)(int nConnectionIndex, char* pData, int nMaxSize);
 typedef void (*drv_socket_on_send_t)(int nConnectionIndex, char* pData, int nSize);
@@ -158,6 +283,115 @@ typedef void (*drv_socket_on_disconnect_t)(int nConnectionIndex);
 typedef void (*drv_socket_on_recvfrom_t)(uint32_t,uint16_t);
 typedef void (*drv_socket_on_sendto_t)(uint32_t*,uint16_t*);
 
+typedef uint32_t drv_socket_connection_id_t;   /* generation (16 bits) : connection index (16 bits) - stable while the connection lives */
+typedef void (*drv_socket_on_connection_t)(drv_socket_connection_id_t nConnectionId);
+typedef void (*drv_socket_on_send_acked_t)(drv_socket_connection_id_t nConnectionId, uint32_t u32Marker, bool bAcked);   /* bAcked false - connection closed first */
+
+typedef struct
+{
+    uint32_t u32Marker;
+    uint32_t u32Offset;                     // lane byte count covering the marked data, tcp sequence number once sent
+    int8_t nLane;                           // send lane, DRV_SOCKET_SEND_LANE_COUNT once passed to the stack
+} drv_socket_ack_mark_t;
+typedef void (*drv_socket_on_watermark_t)(int nConnectionIndex, bool bHigh);
+
+typedef struct
+{
+    uint8_t* pSendBuffer;                   // staged data pulled from the send stream (CONFIG_DRV_SOCKET_MAX_TCP_SEND_SIZE bytes)
+    int nSendBufferOffset;                  // first staged byte not yet accepted by the stack
+    int nSendBufferLength;                  // staged bytes
+    uint16_t u16Generation;                 // incremented on each close of the connection in this slot
+    bool bSendEnable;                       // send allowed (after identification or auto send enable)
+    bool bIndentifyNeeded;                  // identification handshake pending (DRV_SOCKET_TIMER_IDENTIFY)
+    int nSendDeficit;                       // bytes the connection may still send (deficit round robin)
+    uint8_t u8SendWeight;                   // quantums per round (1 - DRV_SOCKET_SEND_WEIGHT_MAX)
+    bool bRecvPaused;                       // receive stream above the high watermark - not read until the low watermark
+    bool bSendHigh;                         // send queue above the high watermark (producers notified)
+    bool bCoalesceFlush;                    // coalescing done (size or deadline reached) - send until the lanes are empty
+    size_t nPingCount;
+    uint32_t u32SendPulled;                 // bytes pulled from the send lanes (latency mark offsets)
+    uint32_t u32RecvPushed;                 // bytes pushed to the receive stream (latency mark offsets)
+    drv_socket_latency_marks_t sendMarks;   // enqueue time samples - consumed on pull
+    int64_t nSendEnqueueUs;                 // first drv_socket_wakeup() with queued send data since the last send mark (0 - none, socket_runtime_lock)
+    drv_socket_latency_marks_t recvMarks;   // push time samples - consumed when the application pulls
+    uint32_t au32LanePulled[DRV_SOCKET_SEND_LANE_COUNT];    // bytes pulled per send lane (ack mark offsets)
+    int8_t nStagedLane;                     // lane of the staged data (-1 - ping or none)
+    drv_socket_ack_mark_t ackMarks[DRV_SOCKET_ACK_MARK_COUNT];
+    uint8_t u8AckMarkCount;
+    uint8_t* pFrameBuffer;                  // multipath: received bytes until a whole frame (CONFIG_DRV_SOCKET_MAX_TCP_SEND_SIZE bytes)
+    int nFrameBufferLength;
+    bool bFrameParked;                      // multipath: next frame ahead of the delivered sequence - not read until the other connection catches up
+    bool bFrameHello;                       // multipath: HELLO frame staged before the first data frame
+
+} drv_socket_connection_t;
+
+typedef struct
+{
+    int nSocket;                            // loopback udp socket included in the select() read set
+    struct sockaddr_storage addr;           // own address - wakeup datagrams are sent here
+    bool bPending;                          // wakeup datagram sent and not yet drained
+
+} drv_socket_wakeup_t;
+
+typedef enum
+{
+    DRV_SOCKET_TIMER_RECONNECT,                 /* next connect attempt not before */
+    DRV_SOCKET_TIMER_INTERFACE_REFRESH,         /* refresh of the cached interface state */
+    DRV_SOCKET_TIMER_DNS_WAIT,                  /* connect with cHostIP if still not resolved */
+    DRV_SOCKET_TIMER_RACE_STAGGER,              /* next endpoint of the connect race */
+    DRV_SOCKET_TIMER_FAILOVER_RETRY,            /* no new failover before (after a failed one) */
+    DRV_SOCKET_TIMER_MULTIPATH_RETRY,           /* no new secondary connect before (after a failed one) */
+    DRV_SOCKET_TIMER_MULTIPATH_STEER,           /* next rtt comparison of the multipath connections */
+    DRV_SOCKET_TIMER_FAILOVER_DRAIN,            /* switch to the failover connection even if the old one is not drained */
+    DRV_SOCKET_TIMER_FAILOVER_POLL,             /* old connection tcp_pcb checked while draining */
+    DRV_SOCKET_TIMER_WATERMARK,                 /* stream fill poll while a watermark is exceeded */
+    DRV_SOCKET_TIMER_LATENCY,                   /* stream fill poll for the latency samples */
+    DRV_SOCKET_TIMER_ACK,                       /* peer ack poll while send markers are pending */
+    DRV_SOCKET_TIMER_CONNECT,                   /* connect attempt deadlines */
+    DRV_SOCKET_TIMER_PING = DRV_SOCKET_TIMER_CONNECT + DRV_SOCKET_CONNECT_ATTEMPT_COUNT,   /* per connection - send idle */
+    DRV_SOCKET_TIMER_IDENTIFY = DRV_SOCKET_TIMER_PING + DRV_SOCKET_SERVER_MAX_CLIENTS,      /* per connection - identification timeout */
+    DRV_SOCKET_TIMER_COALESCE = DRV_SOCKET_TIMER_IDENTIFY + DRV_SOCKET_SERVER_MAX_CLIENTS,  /* per connection - send coalescing deadline */
+    DRV_SOCKET_TIMER_COUNT = DRV_SOCKET_TIMER_COALESCE + DRV_SOCKET_SERVER_MAX_CLIENTS,
+}drv_socket_timer_id_t;
+
+typedef struct
+{
+    TickType_t anDeadline[DRV_SOCKET_TIMER_COUNT];      // expiry tick of each running timer
+    int16_t anHeapPosition[DRV_SOCKET_TIMER_COUNT];     // position in au16Heap (-1 if not running)
+    uint16_t au16Heap[DRV_SOCKET_TIMER_COUNT];          // running timers - min-heap by deadline
+    bool abFired[DRV_SOCKET_TIMER_COUNT];               // expired and not restarted or stopped yet
+    int nHeapCount;
+} drv_socket_timers_t;
+
+typedef struct
+{
+    int nSocket;                            // client socket being connected (-1 if none)
+    bool bInProgress;                       // connect() returned EINPROGRESS - wait for writability
+    int nTimer;                             // deadline timer (drv_socket_timer_id_t)
+    esp_interface_t adapter_if;             // interface the attempt is bound to
+    int nEndpointIndex;                     // endpoint connected (-1 if cURL/cHostIP)
+    struct sockaddr_storage addr;           // host address connected
+    struct sockaddr_storage bind_addr;      // adapter interface address bound to
+    char cBindIP[16];                       // bind_addr as string (for the log)
+    bool bBroadcast;                        // broadcast host - connected only through bind
+} drv_socket_connect_t;
+
+typedef struct
+{
+    char cHost[32];                         // URL or IPv4 address
+    uint16_t u16Port;                       // 0 - use u16Port of the socket
+} drv_socket_endpoint_t;
+
+typedef struct
+{
+    uint8_t u8Version;
+    uint8_t u8InterfaceIndex;               // drv_socket_interface_t of the connection
+    int8_t nEndpointIndex;                  // endpoint connected (-1 if cURL/cHostIP)
+    uint16_t u16Port;
+    char cHost[32];                         // URL or endpoint host the address belongs to
+    char cIP[16];                           // connected address
+} drv_socket_last_good_t;
+
 typedef struct 
 {
     char cAdapterInterfaceIP[16];
@@ -168,6 +402,47 @@ typedef struct
     struct sockaddr_storage host_addr_recv; // Large enough for both IPv4 or IPv6
     struct sockaddr_storage host_addr_send; // Large enough for both IPv4 or IPv6
     esp_interface_t adapter_if;             // the selected if
+    uint8_t* pRecvBuffer;                   // read buffer (CONFIG_DRV_SOCKET_MAX_TCP_READ_SIZE bytes) shared by all connections
+    drv_socket_connection_t connection[DRV_SOCKET_SERVER_MAX_CLIENTS];
+    drv_socket_wakeup_t wakeup;             // own wakeup socket (event driven mode)
+    drv_socket_wakeup_t* pWakeup;           // wakeup socket used by the serving task (NULL in polling mode)
+    uint8_t u8Users;                        // other tasks using the runtime (socket_runtime_get) - not freed before 0
+    fd_set rfds;                            // select() result of the last wait
+    fd_set wfds;
+    bool bEventsValid;                      // rfds/wfds valid (else all descriptors are polled)
+    int nSendNext;                          // connection served first in the next send pass (rotated)
+    QueueHandle_t pAckQueue;                // drv_socket_send_mark() requests from the producers (NULL - onSendAcked not set)
+    drv_socket_timers_t timers;             // all deadlines of the socket - the task sleeps until the nearest one
+    TickType_t nReconnectDelayTicks;        // backoff delay of the next failure (before jitter)
+    int16_t nSlotFreeHead;                  // first free connection index (-1 if all used)
+    int16_t anSlotNextFree[DRV_SOCKET_SERVER_MAX_CLIENTS];    // free connection indexes list
+    drv_socket_connect_t connect;           // pending client connect attempt
+    drv_socket_connect_t failover;          // make-before-break connect attempt on the target interface
+    int nFailoverInterfaceIndex;            // failover target (drv_socket_interface_t) or -1
+    int nFailoverSocket;                    // failover connection established - waits for the old connection to drain (-1 none)
+    drv_socket_connect_t multipath;         // connect attempt of the secondary (multipath) connection
+    int nMultipathIndex;                    // connection index of the secondary connection or -1
+    esp_interface_t multipath_if;           // interface of the secondary connection
+    int nMultipathActiveIndex;              // connection index the new frames are staged on
+    uint32_t u32FrameSession;               // multipath session id (HELLO frames) - new one when the first connection opens
+    uint32_t u32FrameSendSeq;               // sequence of the next frame sent
+    uint32_t u32FrameRecvSeq;               // sequence of the next frame delivered to the receive stream
+    int nFrameSendLength;                   // payload length of the frame whose queue header is pulled (-1 - none)
+    uint8_t u8FrameSendFlags;
+    bool bHostIPFallback;                   // next attempt uses cHostIP instead of the resolved URL
+    uint16_t u16HostPort;                   // port of the host address being prepared
+    drv_socket_connect_t race[DRV_SOCKET_CONNECT_RACE_COUNT];   // parallel connect attempts to the endpoints
+    bool bRacing;
+    int nRaceNext;                          // next position in the endpoint order
+    int nEndpointWinner;                    // endpoint of the last successful connect (tried first) or -1
+    int nEndpointIndex;                     // endpoint of the current connection or -1
+    char cEndpointIP[16];                   // address of nEndpointIndex
+    drv_socket_last_good_t lastGood;        // last successful connect (persisted)
+    bool bLastGoodValid;                    // lastGood matches the configuration - connect without waiting for the resolve
+    bool bLastGoodAttempt;                  // current attempt uses the lastGood address
+    bool bDnsWait;                          // connect waits for the background resolve of cURL
+    bool abInterfaceConnected[2];           // cached state of adapter_interface[] (refreshed on IP/WIFI/ETH events)
+    uint32_t u32InterfaceEventCount;        // interface events count at the last refresh
 
 } drv_socket_runtime_t;
 
@@ -175,17 +450,26 @@ typedef struct
 typedef struct
 {
 
-    int nSocketIndexPrimer[DRV_SOCKET_SERVER_MAX_CLIENTS];
+    int nSocketIndexPrimer[DRV_SOCKET_SERVER_MAX_CLIENTS];     /* indexed by connection index (stable slot, -1 if free) */
     int nSocketIndexServer;
+    int nListenBacklog;             /* server listen backlog (0 - CONFIG_DRV_SOCKET_SERVER_LISTEN_BACKLOG) */
+    int nConnectTimeoutMs;          /* client connect deadline (0 - CONFIG_DRV_SOCKET_CONNECT_TIMEOUT_MS) */
+    int nReconnectTimeMinMs;        /* initial reconnect delay, doubled on each failure (0 - 5000 ms) */
+    int nReconnectTimeMaxMs;        /* reconnect delay limit (0 - CONFIG_DRV_SOCKET_RECONNECT_TIME_MAX_MS) */
     int nSocketConnectionsCount;
     bool bServerType;
     bool bActiveTask;
     bool bConnected;
-    bool bSendEnable;               
     bool bSendFillEnable;               /* Used always to be able to fill send data to send stream (used outside of drv_socket.c) */
     bool bAutoSendEnable;
     bool bIndentifyForced;
+    /* deprecated - the handshake state is per connection (drv_socket_get_send_enable()). These mirror the
+       connection updated last; nPingTicks and nTimeoutSendEnable stay 0 (deadlines are in the timer heap) */
+    bool bSendEnable;
     bool bIndentifyNeeded;
+    size_t nPingTicks;
+    size_t nPingCount;
+    size_t nTimeoutSendEnable;
     bool bResetSendStreamOnConnect;
     bool bPingUse;
     bool bLineEndingFixCRLFToCR;
@@ -196,17 +480,37 @@ typedef struct
     bool bConnectDenySTA;
     bool bConnectDenyAP;
     bool bPriorityBackupAdapterInterface;
-    bool bPreventOverflowReceivedData;
-    bool bNonBlockingMode;  /* for now only for client sockets (to do if needed for the server socket's accepted clients ) */
+    bool bFailoverMakeBeforeBreak;      /* client sockets: connect on the new interface before closing the current connection.
+                                           The send stream is held until the old connection is drained (all bytes acked), then
+                                           continues on the new one. If not drained in time the bytes in flight are lost - the
+                                           staged data is dropped too and the new connection id (onConnectionClose/Open) marks
+                                           where the application has to restart its stream at a frame boundary */
+    bool bPersistEndpoint;              /* client sockets: store the last connected address, port and interface (NVS) and
+                                           connect to it at once after restart while the URL is resolved in the background */
+    drv_socket_multipath_t multipath;   /* TCP client sockets: second connection on the other interface. Data is sent with
+                                           drv_socket_frame_send() and received from pRecvStreamBuffer[0] (payloads only),
+                                           framed and sequenced on the wire (DRV_SOCKET_FRAME_*). Lanes, coalescing, ping,
+                                           identification and make-before-break failover are not used */
+    bool bNonBlockingMode;  /* client socket and server socket's accepted clients (unsent tail kept and retried when writable) */
+    bool bEventDrivenMode;  /* block in select() until socket activity or drv_socket_wakeup() instead of fixed rest time polling */
+    bool bNoDelay;          /* TCP_NODELAY - Nagle off (always on with coalescing) */
+    int nCoalesceSize;      /* TCP: hold send data until this many bytes are queued (0 - off, control lane never held) */
+    int nCoalesceTimeMs;    /* TCP: max hold time of queued data (0 - DRV_SOCKET_COALESCE_TIME_MS, min one tick) */
+    bool bPreventOverflowReceivedData;  /* deprecated - reads are always limited to the free space of the receive stream.
+                                           Set: the default high watermark is the full stream (paused only when full) */
+    int nRecvHighWatermark; /* receive stream fill - connection not read above it, data stays in the TCP window (0 - 3/4 of the stream) */
+    int nRecvLowWatermark;  /* receive stream fill - reading resumed (0 - 1/4 of the stream) */
+    int nSendHighWatermark; /* send queue fill (all lanes) - onSendWatermark(high) to throttle the producers (0 - off) */
+    int nSendLowWatermark;  /* send queue fill - onSendWatermark(low) */
     #ifdef CONFIG_EXAMPLE_IPV6
     bool bIPV6;
     #endif
 
-    size_t nPingTicks;
-    size_t nPingCount;
-    size_t nTimeoutSendEnable;
-
     int nTaskLoopCounter;
+    bool bLatencyStats;     /* sample stream latencies into pLatency histograms (send enqueue stamped by drv_socket_wakeup(), else by the stream fill poll every DRV_SOCKET_LATENCY_POLL_TIME_MS) */
+    drv_socket_latency_t* pLatency;     /* DRV_SOCKET_SERVER_MAX_CLIENTS entries - allocated at first start with bLatencyStats and kept */
+    drv_socket_stats_t stats;
+    drv_socket_connection_stats_t connectionStats[DRV_SOCKET_SERVER_MAX_CLIENTS];
 
 
     char cName[8];
@@ -214,6 +518,8 @@ typedef struct
     char cHostIPResolved[16];
     char cURL[32];
     uint16_t u16Port;
+    drv_socket_endpoint_t endpoint[DRV_SOCKET_ENDPOINT_COUNT_MAX];     /* if any - raced instead of cURL/cHostIP (drv_socket_endpoint_add/clear while the task is stopped) */
+    int nEndpointCount;
     esp_interface_t adapter_interface[2];
 
     drv_socket_address_family_t address_family;
@@ -221,16 +527,23 @@ typedef struct
     drv_socket_protocol_t protocol;
     drv_socket_protocol_type_t protocol_type;
 
-    TaskHandle_t pTask;
+    TaskHandle_t pTask;                 /* serving task - own task or shared reactor task */
     drv_socket_on_connect_t onConnect;
     drv_socket_on_receive_t onReceive;
     drv_socket_on_send_t onSend;
     drv_socket_on_disconnect_t onDisconnect;
     drv_socket_on_recvfrom_t onReceiveFrom;
     drv_socket_on_sendto_t onSendTo;
+    drv_socket_on_connection_t onConnectionOpen;
+    drv_socket_on_connection_t onConnectionClose;
+    drv_socket_on_send_acked_t onSendAcked;     /* TCP: peer acknowledged the data marked by drv_socket_send_mark() (set before start) */
+    drv_socket_on_watermark_t onRecvWatermark;
+    drv_socket_on_watermark_t onSendWatermark;
     drv_socket_runtime_t* pRuntime;
     struct sockaddr_storage nSocketIndexPrimerIP[DRV_SOCKET_SERVER_MAX_CLIENTS];
     StreamBufferHandle_t * pSendStreamBuffer[DRV_SOCKET_SERVER_MAX_CLIENTS];
+    StreamBufferHandle_t * pSendStreamBufferControl[DRV_SOCKET_SERVER_MAX_CLIENTS];    /* optional lanes (NULL - not used): control sent before pSendStreamBuffer, */
+    StreamBufferHandle_t * pSendStreamBufferBulk[DRV_SOCKET_SERVER_MAX_CLIENTS];       /* bulk after it. Lanes switch at chunk boundaries - the data of each lane must be self delimiting */
     StreamBufferHandle_t * pRecvStreamBuffer[DRV_SOCKET_SERVER_MAX_CLIENTS];
 
     //size_t nSetupSocketTxBufferSize;  //not implemented in esp-idf
@@ -249,14 +562,29 @@ typedef struct
  * Function Prototypes
  **************************************************************************** */
 void drv_socket_list(void);
+void drv_socket_stats(drv_socket_t* pSocket, bool bReset);
+bool drv_socket_tcp_info_get(drv_socket_t* pSocket, int nConnectionIndex, drv_socket_tcp_info_t* pInfo);
+void drv_socket_tcp_info(drv_socket_t* pSocket);
+bool drv_socket_send_mark(drv_socket_t* pSocket, drv_socket_connection_id_t nConnectionId, drv_socket_send_lane_t lane, uint32_t u32Marker);
+int drv_socket_get_bytes_in_flight(drv_socket_t* pSocket, drv_socket_connection_id_t nConnectionId);
+bool drv_socket_latency_get(drv_socket_t* pSocket, int nConnectionIndex, bool bRecv, drv_socket_latency_summary_t* pSummary);
 int drv_socket_get_position(const char* name);
 drv_socket_t* drv_socket_get_handle(const char* name);
+void drv_socket_wakeup(drv_socket_t* pSocket);
+drv_socket_connection_id_t drv_socket_get_connection_id(drv_socket_t* pSocket, int nConnectionIndex);
+int drv_socket_get_connection_index(drv_socket_t* pSocket, drv_socket_connection_id_t nConnectionId);
+bool drv_socket_get_send_enable(drv_socket_t* pSocket, int nConnectionIndex);
+bool drv_socket_set_send_weight(drv_socket_t* pSocket, drv_socket_connection_id_t nConnectionId, int nWeight);
+bool drv_socket_frame_send(drv_socket_t* pSocket, const uint8_t* pData, int nLength, bool bCritical);
 void drv_socket_disconnect(drv_socket_t* pSocket);
 void drv_socket_url_set(drv_socket_t* pSocket, const char* url);
 void drv_socket_ip_address_set(drv_socket_t* pSocket, const char* ip_address);
+bool drv_socket_endpoint_add(drv_socket_t* pSocket, const char* host, uint16_t port);
+bool drv_socket_endpoint_clear(drv_socket_t* pSocket);
 void drv_socket_stop(drv_socket_t* pSocket);
 void drv_socket_start(drv_socket_t* pSocket);
 esp_err_t drv_socket_task(drv_socket_t* pSocket, int priority);
+esp_err_t drv_socket_reactor_task(drv_socket_t* pSocket, int priority);
 void drv_socket_init(void);
 
 